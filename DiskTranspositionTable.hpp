@@ -0,0 +1,173 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISK_TRANSPOSITION_TABLE_HPP
+#define DISK_TRANSPOSITION_TABLE_HPP
+
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Disk Transposition Table is a second tier transposition table stored in a memory mapped file.
+ * It is intended to be much larger than memory and to be stored on a fast local drive:
+ * only expensive results should be stored, and it should only be probed where the
+ * search saved by a hit is worth the I/O latency.
+ *
+ * Like TranspositionTable, it is a simple hash map with fixed storage size,
+ * keeping the last entry in case of collision. Full keys are stored.
+ * The file content is kept between runs, as stored values remain valid for
+ * the same board and the same encoding of the scores: both are part of the header,
+ * and an existing file with another header is never overwritten.
+ *
+ * File format:
+ * - 1 byte: key size in bytes
+ * - 1 byte: value size in bytes
+ * - 1 byte: log_size = log2(size)
+ * - 1 byte: board width
+ * - 1 byte: board height
+ * - 1 byte: min score (signed), offset of the encoding of the scores in values
+ * - 1 byte: max score (signed)
+ * - 1 byte: padding
+ * - size entries (key, value)
+ */
+template<class key_t, class value_t>
+class DiskTranspositionTable {
+ private:
+  static constexpr size_t HEADER_SIZE = 8;
+  struct Entry {
+    key_t key;
+    value_t value;
+  };
+  size_t size;     // number of entries, 0 if the table is not opened
+  size_t length;   // length of the mapped file
+  char *data;      // mapped file
+  Entry *entries;  // entries of the mapped file
+  const int width, height;       // board size
+  const int minScore, maxScore;  // encoding of the scores
+
+  size_t index(key_t key) const {
+    return key % size;
+  }
+
+ public:
+  DiskTranspositionTable(int width, int height, int min_score, int max_score) :
+    size{0}, length{0}, data{nullptr}, entries{nullptr}, width{width}, height{height}, minScore{min_score}, maxScore{max_score} {}
+
+  ~DiskTranspositionTable() {
+    close();
+  }
+
+  /**
+   * Open or create the file storing the table.
+   * An existing non empty file with a different format or size is left untouched and not opened.
+   * @param filename: file to map.
+   * @param log_size: the table contains 2^log_size + 1 entries.
+   * @return true in case of success.
+   */
+  bool open(const std::string &filename, int log_size) {
+    close();
+    size_t new_size = (size_t(1) << log_size) + 1; // odd size to be prime with 2^sizeof(key_t)
+    length = HEADER_SIZE + new_size * sizeof(Entry);
+    int fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+      std::cerr << "Unable to open disk transposition table: " << filename << std::endl;
+      return false;
+    }
+    struct stat st;
+    char header[HEADER_SIZE] = {sizeof(key_t), sizeof(value_t), char(log_size), char(width), char(height), char(minScore), char(maxScore)};
+    char file_header[HEADER_SIZE] = {0};
+    if(fstat(fd, &st)) {
+      std::cerr << "Unable to open disk transposition table: " << filename << std::endl;
+      ::close(fd);
+      return false;
+    }
+    if(st.st_size != 0) { // existing table: only used if it has the same format
+      if(size_t(st.st_size) != length || pread(fd, file_header, HEADER_SIZE, 0) != HEADER_SIZE
+          || !std::equal(header, header + HEADER_SIZE, file_header)) {
+        std::cerr << "Not a disk transposition table of this size for this board, left untouched: " << filename << std::endl;
+        ::close(fd);
+        return false;
+      }
+    } else { // new file: create an empty table (sparse file filled with 0)
+      if(ftruncate(fd, length) || pwrite(fd, header, HEADER_SIZE, 0) != HEADER_SIZE) {
+        std::cerr << "Unable to create disk transposition table: " << filename << std::endl;
+        ::close(fd);
+        return false;
+      }
+    }
+    void *map = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(map == MAP_FAILED) {
+      std::cerr << "Unable to map disk transposition table: " << filename << std::endl;
+      return false;
+    }
+    madvise(map, length, MADV_RANDOM); // no read ahead, accesses are random
+    data = static_cast<char *>(map);
+    entries = reinterpret_cast<Entry *>(data + HEADER_SIZE);
+    size = new_size;
+    return true;
+  }
+
+  /**
+   * Unmap the file, modified entries are written back by the system.
+   */
+  void close() {
+    if(data) munmap(data, length);
+    data = nullptr;
+    entries = nullptr;
+    size = 0;
+  }
+
+  /**
+   * @return true if the table is opened.
+   */
+  bool isOpen() const {
+    return size != 0;
+  }
+
+  /**
+   * Store a value for a given key
+   * @param value: null (0) value is used to encode missing data
+   */
+  void put(key_t key, value_t value) {
+    Entry &e = entries[index(key)];
+    e.key = key;
+    e.value = value;
+  }
+
+  /**
+   * Get the value of a key
+   * @return value associated with the key if present, 0 otherwise.
+   */
+  value_t get(key_t key) const {
+    const Entry &e = entries[index(key)];
+    return e.key == key ? e.value : 0;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
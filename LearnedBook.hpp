@@ -0,0 +1,153 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LEARNED_BOOK_HPP
+#define LEARNED_BOOK_HPP
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdint>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Learned Book is a supplementary book of interior positions whose search was expensive,
+ * recorded while solving real queries. Unlike the opening book, it does not cover all the
+ * positions up to a depth and can be incomplete: it keeps the best lower and upper bounds
+ * proven for each position, the score being exact when both bounds are equal.
+ *
+ * Full keys are stored in a hash map, the book is expected to stay small enough for memory.
+ *
+ * File format:
+ * - 1 byte: board width
+ * - 1 byte: board height
+ * - 1 byte: key size in bytes
+ * - entries (key, min, max) with a 1 byte signed min and max
+ */
+template<class key_t>
+class LearnedBook {
+ private:
+  struct Bounds {
+    int8_t min;
+    int8_t max;
+  };
+  std::unordered_map<key_t, Bounds> entries;
+  int width;
+  int height;
+
+ public:
+  LearnedBook(int width, int height) : width{width}, height{height} {}
+
+  /**
+   * Load a learned book file, replacing the current content.
+   * A missing file gives an empty book.
+   * @return false if the file cannot be read or has another format, the book is then empty.
+   */
+  bool load(const std::string &filename) {
+    entries.clear();
+    std::ifstream ifs(filename, std::ios::binary);
+    if(ifs.fail()) return true; // nothing learned yet
+    char header[3];
+    ifs.read(header, 3);
+    if(ifs.fail() || header[0] != width || header[1] != height || header[2] != sizeof(key_t)) {
+      std::cerr << "Invalid learned book: " << filename << std::endl;
+      return false;
+    }
+    key_t key;
+    Bounds b;
+    while(ifs.read(reinterpret_cast<char *>(&key), sizeof(key)) && ifs.read(reinterpret_cast<char *>(&b), sizeof(b)))
+      entries[key] = b;
+    if(!ifs.eof()) {
+      std::cerr << "Unable to load learned book: " << filename << std::endl;
+      entries.clear();
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Save the book to a file. The file is written under a temporary name and renamed,
+   * so that an interruption never corrupts a previously saved book.
+   * @return true in case of success.
+   */
+  bool save(const std::string &filename) const {
+    std::string tmp_file = filename + ".tmp";
+    std::ofstream ofs(tmp_file, std::ios::binary);
+    char header[3] = {char(width), char(height), sizeof(key_t)};
+    ofs.write(header, 3);
+    for(const std::pair<const key_t, Bounds> &e : entries) {
+      ofs.write(reinterpret_cast<const char *>(&e.first), sizeof(e.first));
+      ofs.write(reinterpret_cast<const char *>(&e.second), sizeof(e.second));
+    }
+    ofs.close();
+    if(ofs.fail() || std::rename(tmp_file.c_str(), filename.c_str())) {
+      std::cerr << "Unable to save learned book: " << filename << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Record a proven bound of the score of a position, keeping the best known bounds.
+   * @param min, max: interval proven to contain the score.
+   */
+  void put(key_t key, int min, int max) {
+    typename std::unordered_map<key_t, Bounds>::iterator it = entries.find(key);
+    if(it == entries.end()) {
+      entries[key] = Bounds{int8_t(min), int8_t(max)};
+      return;
+    }
+    if(min > it->second.min) it->second.min = min;
+    if(max < it->second.max) it->second.max = max;
+  }
+
+  /**
+   * Get the bounds of a position.
+   * @return true if the position is in the book, then [min;max] is the interval proven to contain its score.
+   */
+  bool get(key_t key, int &min, int &max) const {
+    typename std::unordered_map<key_t, Bounds>::const_iterator it = entries.find(key);
+    if(it == entries.end()) return false;
+    min = it->second.min;
+    max = it->second.max;
+    return true;
+  }
+
+  bool empty() const {
+    return entries.empty();
+  }
+
+  size_t size() const {
+    return entries.size();
+  }
+
+  // @return the number of positions whose exact score is known
+  size_t nbExact() const {
+    size_t n = 0;
+    for(const std::pair<const key_t, Bounds> &e : entries) n += e.second.min == e.second.max;
+    return n;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -0,0 +1,110 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOVE_ORDERING_HPP
+#define MOVE_ORDERING_HPP
+
+#include <string>
+#include <sstream>
+#include "Position.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * This class computes the score used to sort the next moves to explore.
+ *
+ * The score of a move is a weighted sum of several features:
+ * - OWN_THREATS:     number of winning spots of the current player after the move
+ * - BLOCKED_THREATS: number of winning spots the opponent would get by playing the move
+ * - PARITY_THREATS:  number of winning spots after the move on the rows favorable to the current player
+ * - CENTRALITY:      distance of the column of the move to the border of the board
+ * - UNDER_THREAT:    1 if the move is played two cells below an opponent winning spot
+ *
+ * Default weights only use OWN_THREATS. Other weights can be found using the tuner tool.
+ * Only features having a non null weight are computed.
+ */
+class MoveOrdering {
+ public:
+  enum Feature {OWN_THREATS, BLOCKED_THREATS, PARITY_THREATS, CENTRALITY, UNDER_THREAT, NB_FEATURES};
+
+  int weight[NB_FEATURES]; // weight of each feature
+
+  /**
+   * Score a possible move.
+   *
+   * @param P: the position to play from.
+   * @param move: a possible move given in a bitmap format.
+   * @param col: 0-based index of the column of the move.
+   */
+  int score(const Position &P, const Position::position_t move, const int col) const {
+    int s = 0;
+    if(weight[OWN_THREATS]) s += weight[OWN_THREATS] * P.moveScore(move);
+    if(weight[BLOCKED_THREATS]) s += weight[BLOCKED_THREATS] * P.blockScore(move);
+    if(weight[PARITY_THREATS]) s += weight[PARITY_THREATS] * P.parityScore(move);
+    if(weight[CENTRALITY]) s += weight[CENTRALITY] * (Position::WIDTH / 2 - (col < Position::WIDTH / 2 ? Position::WIDTH / 2 - col : col - Position::WIDTH / 2));
+    if(weight[UNDER_THREAT]) s += weight[UNDER_THREAT] * P.underThreatScore(move);
+    return s;
+  }
+
+  /**
+   * Parse weights given as a comma separated list of integers, in the order of the features.
+   * Missing trailing weights are set to 0.
+   * @return true in case of success, false if the string is invalid (weights are then unchanged).
+   */
+  bool parse(const std::string &str) {
+    int w[NB_FEATURES] = {0};
+    std::istringstream iss(str);
+    for(int i = 0; i < NB_FEATURES && !iss.eof(); i++) {
+      if(!(iss >> w[i])) return false;
+      if(!iss.eof() && iss.get() != ',') return false;
+    }
+    if(!iss.eof()) return false; // too many weights
+    for(int i = 0; i < NB_FEATURES; i++) weight[i] = w[i];
+    return true;
+  }
+
+  /**
+   * @return weights as a comma separated list of integers, in the order of the features.
+   */
+  std::string toString() const {
+    std::ostringstream oss;
+    for(int i = 0; i < NB_FEATURES; i++) oss << (i ? "," : "") << weight[i];
+    return oss.str();
+  }
+
+  /**
+   * @return true if the weights are the default ones, the score of a move is then P.moveScore(move).
+   */
+  bool isDefault() const {
+    if(weight[OWN_THREATS] != 1) return false;
+    for(int i = OWN_THREATS + 1; i < NB_FEATURES; i++)
+      if(weight[i]) return false;
+    return true;
+  }
+
+  /**
+   * Build the default move ordering, only based on the number of winning spots.
+   */
+  MoveOrdering(): weight{1, 0, 0, 0, 0} {
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
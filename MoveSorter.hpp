@@ -30,10 +30,11 @@ namespace Connect4 {
  * You have to add moves first with their score
  * then you can get them back in decreasing score
  *
- * This class implement an insertion sort that is in practice very
- * efficient for small number of move to sort (max is Position::WIDTH)
- * and also efficient if the move are pushed in approximatively increasing
- * order which can be acheived by using a simpler column ordering heuristic.
+ * Each score is packed with the index of its move into a single 64 bits key,
+ * the low bits holding the index so that among equal scores the last added move
+ * comes first. getNext selects the max key of a fixed size array with conditional
+ * moves: there is no data-dependent branch on the (small and random) scores and
+ * the remaining moves are not sorted when a cut-off happens after the first ones.
  */
 class MoveSorter {
  public:
@@ -43,10 +44,9 @@ class MoveSorter {
    * You cannot add more than Position::WIDTH moves
    */
   void add(const Position::position_t move, const int score) {
-    int pos = size++;
-    for(; pos && entries[pos - 1].score > score; --pos) entries[pos] = entries[pos - 1];
-    entries[pos].move = move;
-    entries[pos].score = score;
+    moves[size] = move;
+    keys[size] = uint64_t(uint32_t(score) ^ 0x80000000u) << INDEX_BITS | size; // unsigned order of the scores is kept
+    size++;
   }
 
   /**
@@ -55,10 +55,12 @@ class MoveSorter {
    * If no more move is available return 0
    */
   Position::position_t getNext() {
-    if(size)
-      return entries[--size].move;
-    else
-      return 0;
+    uint64_t max = 0;
+    for(int i = 0; i < Position::WIDTH; i++) max = keys[i] > max ? keys[i] : max;
+    if(!max) return 0;
+    const unsigned int index = max & ((1 << INDEX_BITS) - 1);
+    keys[index] = 0;
+    return moves[index];
   }
 
   /**
@@ -66,23 +68,28 @@ class MoveSorter {
    */
   void reset() {
     size = 0;
+    for(int i = 0; i < Position::WIDTH; i++) keys[i] = 0;
   }
 
   /**
    * Build an empty container
    */
-  MoveSorter(): size{0} {
+  MoveSorter() {
+    reset();
   }
 
  private:
-  // number of stored moves
+  static constexpr int INDEX_BITS = 4;
+  static_assert(Position::WIDTH <= 1 << INDEX_BITS, "Move index does not fit into the sort keys");
+
+  // number of added moves
   unsigned int size;
 
-  // Contains size moves with their score ordered by score
-  struct {
-    Position::position_t move;
-    int score;
-  } entries[Position::WIDTH];
+  // sort key of each added move, 0 for empty or already returned slots
+  uint64_t keys[Position::WIDTH];
+
+  // added moves, in insertion order
+  Position::position_t moves[Position::WIDTH];
 };
 
 } // namespace Connect4
@@ -21,55 +21,108 @@
 
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
 #include "Position.hpp"
 #include "TranspositionTable.hpp"
 
 namespace GameSolver {
 namespace Connect4 {
 
+/**
+ * Opening book storing the scores of all the positions up to a given depth.
+ *
+ * A first book can be loaded by a thread while other threads are looking positions up:
+ * the book is considered empty until the load is complete.
+ * Loading another book while the book is in use is not supported.
+ */
 class OpeningBook {
   TableGetter<Position::position_t, uint8_t> *T;
   const int width;
   const int height;
-  int depth;
+  std::atomic<int> depth; // -1 until a book is published, so that it can be loaded while solving
+
+  // @param data: content of the table to use without copy, or nullptr to allocate an empty table
+  template<class partial_key_t, int log_size>
+  TableGetter<Position::position_t, uint8_t>* newTranspositionTable(const char *data) {
+    if(data) return new TranspositionTable<partial_key_t, Position::position_t, uint8_t, log_size>(data);
+    else return new TranspositionTable<partial_key_t, Position::position_t, uint8_t, log_size>();
+  }
 
   template<class partial_key_t>
-  TableGetter<Position::position_t, uint8_t>* initTranspositionTable(int log_size) {
+  TableGetter<Position::position_t, uint8_t>* initTranspositionTable(int log_size, const char *data) {
     switch(log_size) {
     case 21:
-      return new TranspositionTable<partial_key_t, Position::position_t, uint8_t, 21>();
+      return newTranspositionTable<partial_key_t, 21>(data);
     case 22:
-      return new TranspositionTable<partial_key_t, Position::position_t, uint8_t, 22>();
+      return newTranspositionTable<partial_key_t, 22>(data);
     case 23:
-      return new TranspositionTable<partial_key_t, Position::position_t, uint8_t, 23>();
+      return newTranspositionTable<partial_key_t, 23>(data);
     case 24:
-      return new TranspositionTable<partial_key_t, Position::position_t, uint8_t, 24>();
+      return newTranspositionTable<partial_key_t, 24>(data);
     case 25:
-      return new TranspositionTable<partial_key_t, Position::position_t, uint8_t, 25>();
+      return newTranspositionTable<partial_key_t, 25>(data);
     case 26:
-      return new TranspositionTable<partial_key_t, Position::position_t, uint8_t, 26>();
+      return newTranspositionTable<partial_key_t, 26>(data);
     case 27:
-      return new TranspositionTable<partial_key_t, Position::position_t, uint8_t, 27>();
+      return newTranspositionTable<partial_key_t, 27>(data);
     default:
       std::cerr << "Unimplemented OpeningBook size: " << log_size << std::endl;
       return 0;
     }
   }
 
-  TableGetter<Position::position_t, uint8_t>* initTranspositionTable(int partial_key_bytes, int log_size) {
+  TableGetter<Position::position_t, uint8_t>* initTranspositionTable(int partial_key_bytes, int log_size, const char *data = 0) {
     switch(partial_key_bytes) {
     case 1:
-      return initTranspositionTable<uint8_t>(log_size);
+      return initTranspositionTable<uint8_t>(log_size, data);
     case 2:
-      return initTranspositionTable<uint16_t>(log_size);
+      return initTranspositionTable<uint16_t>(log_size, data);
     case 4:
-      return initTranspositionTable<uint32_t>(log_size);
+      return initTranspositionTable<uint32_t>(log_size, data);
     default:
       std::cerr << "Invalid internal key size: " << partial_key_bytes << " bytes" << std::endl;
       return 0;
     }
   }
 
+  static constexpr int HEADER_SIZE = 6;
+
+  /**
+   * Check the header of an opening book.
+   * @return true if the header is valid, otherwise print an error message and return false.
+   */
+  bool checkHeader(const char *header) const {
+    const char _width = header[0], _height = header[1], _depth = header[2];
+    const char partial_key_bytes = header[3], value_bytes = header[4], log_size = header[5];
+    if(_width != width) {
+      std::cerr << "Unable to load opening book: invalid width (found: " << int(_width) << ", expected: " << width << ")" << std::endl;
+      return false;
+    }
+    if(_height != height) {
+      std::cerr << "Unable to load opening book: invalid height(found: " << int(_height) << ", expected: " << height << ")"  << std::endl;
+      return false;
+    }
+    if(_depth > width * height) {
+      std::cerr << "Unable to load opening book: invalid depth (found: " << int(_depth) << ")"  << std::endl;
+      return false;
+    }
+    if(partial_key_bytes > 8) {
+      std::cerr << "Unable to load opening book: invalid internal key size(found: " << int(partial_key_bytes) << ")"  << std::endl;
+      return false;
+    }
+    if(value_bytes != 1) {
+      std::cerr << "Unable to load opening book: invalid value size (found: " << int(value_bytes) << ", expected: 1)"  << std::endl;
+      return false;
+    }
+    if(log_size > 40) {
+      std::cerr << "Unable to load opening book: invalid log2(size)(found: " << int(log_size) << ")"  << std::endl;
+      return false;
+    }
+    return true;
+  }
+
  public:
   OpeningBook(int width, int height) : T{0}, width{width}, height{height}, depth{ -1} {} // Empty opening book
 
@@ -88,6 +141,7 @@ class OpeningBook {
   void load(std::string filename) {
     depth = -1;
     delete T;
+    T = 0;
     std::ifstream ifs(filename, std::ios::binary); // open file
 
     if(ifs.fail()) {
@@ -95,56 +149,63 @@ class OpeningBook {
       return;
     } else std::cerr << "Loading opening book from file: " << filename << ". ";
 
-    char _width, _height, _depth, value_bytes, partial_key_bytes, log_size;
-
-    ifs.read(&_width, 1);
-    if(ifs.fail() || _width != width) {
-      std::cerr << "Unable to load opening book: invalid width (found: " << int(_width) << ", expected: " << width << ")" << std::endl;
-      return;
-    }
-
-    ifs.read(&_height, 1);
-    if(ifs.fail() || _height != height) {
-      std::cerr << "Unable to load opening book: invalid height(found: " << int(_height) << ", expected: " << height << ")"  << std::endl;
-      return;
-    }
-
-    ifs.read(&_depth, 1);
-    if(ifs.fail() || _depth > width * height) {
-      std::cerr << "Unable to load opening book: invalid depth (found: " << int(_depth) << ")"  << std::endl;
-      return;
-    }
-
-    ifs.read(&partial_key_bytes, 1);
-    if(ifs.fail() || partial_key_bytes > 8) {
-      std::cerr << "Unable to load opening book: invalid internal key size(found: " << int(partial_key_bytes) << ")"  << std::endl;
+    char header[HEADER_SIZE];
+    ifs.read(header, HEADER_SIZE);
+    if(ifs.fail()) {
+      std::cerr << "Unable to load opening book: truncated header" << std::endl;
       return;
     }
+    if(!checkHeader(header)) return;
 
-    ifs.read(&value_bytes, 1);
-    if(ifs.fail() || value_bytes != 1) {
-      std::cerr << "Unable to load opening book: invalid value size (found: " << int(value_bytes) << ", expected: 1)"  << std::endl;
-      return;
+    if((T = initTranspositionTable(header[3], header[5]))) {
+      ifs.read(reinterpret_cast<char *>(T->getKeys()), T->getSize() * header[3]);
+      ifs.read(reinterpret_cast<char *>(T->getValues()), T->getSize() * header[4]);
+      if(ifs.fail()) {
+        std::cerr << "Unable to load data from opening book" << std::endl;
+        return;
+      }
+      depth.store(header[2], std::memory_order_release); // set it in case of success only, keep -1 in case of failure
+      std::cerr << "done" << std::endl;
     }
+    else std::cerr << "Unable to initialize opening book" << std::endl;
+    ifs.close();
+  }
 
-    ifs.read(&log_size, 1);
-    if(ifs.fail() || log_size > 40) {
-      std::cerr << "Unable to load opening book: invalid log2(size)(found: " << int(log_size) << ")"  << std::endl;
+  /**
+   * Use an opening book already in memory, with the same format as the files.
+   * When the tables are suitably aligned (data + 6 aligned on the key size), the memory is used
+   * without copy and must outlive the opening book. Otherwise the content is copied.
+   * @param data: content of an opening book file
+   * @param length: size of the content in bytes
+   */
+  void load(const char *data, size_t length) {
+    depth = -1;
+    delete T;
+    T = 0;
+    if(length < HEADER_SIZE) {
+      std::cerr << "Unable to load opening book: truncated header" << std::endl;
       return;
     }
-
-    if((T = initTranspositionTable(partial_key_bytes, log_size))) {
-      ifs.read(reinterpret_cast<char *>(T->getKeys()), T->getSize() * partial_key_bytes);
-      ifs.read(reinterpret_cast<char *>(T->getValues()), T->getSize() * value_bytes);
-      if(ifs.fail()) {
+    if(!checkHeader(data)) return;
+
+    const char *tables = data + HEADER_SIZE;
+    const int partial_key_bytes = data[3], value_bytes = data[4];
+    const bool aligned = partial_key_bytes > 0 && reinterpret_cast<uintptr_t>(tables) % partial_key_bytes == 0;
+    if((T = initTranspositionTable(partial_key_bytes, data[5], aligned ? tables : 0))) {
+      const size_t keys_length = T->getSize() * partial_key_bytes, values_length = T->getSize() * value_bytes;
+      if(length < HEADER_SIZE + keys_length + values_length) {
         std::cerr << "Unable to load data from opening book" << std::endl;
+        delete T;
+        T = 0;
         return;
       }
-      depth = _depth; // set it in case of success only, keep -1 in case of failure
-      std::cerr << "done" << std::endl;
+      if(!aligned) {
+        memcpy(T->getKeys(), tables, keys_length);
+        memcpy(T->getValues(), tables + keys_length, values_length);
+      }
+      depth.store(data[2], std::memory_order_release);
     }
     else std::cerr << "Unable to initialize opening book" << std::endl;
-    ifs.close();
   }
 
   void save(const std::string output_file) const {
@@ -168,8 +229,12 @@ class OpeningBook {
     ofs.close();
   }
 
+  int getDepth() const {
+    return depth.load(std::memory_order_acquire);
+  }
+
   int get(const Position &P) const {
-    if(P.nbMoves() > depth) return 0;
+    if(P.nbMoves() > depth.load(std::memory_order_acquire)) return 0; // the table is only read once published
     else return T->get(P.key3());
   }
 
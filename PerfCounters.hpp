@@ -0,0 +1,130 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Hardware performance counters of the current thread, read with the Linux perf_event_open interface.
+ *
+ * Each counter is opened independently, so that the kernel can multiplex them
+ * if the CPU does not have enough hardware counters. Values are then scaled
+ * by the ratio of enabled time over running time.
+ * Counters not supported by the CPU, the kernel or the permissions (see
+ * /proc/sys/kernel/perf_event_paranoid) are reported as not available.
+ */
+class PerfCounters {
+ public:
+  enum Counter {CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, NB_COUNTERS};
+
+  /**
+   * @return name of a counter
+   */
+  static const char* name(int counter) {
+    static const char* names[NB_COUNTERS] = {"cycles", "instructions", "L1d_misses", "LLC_misses", "dTLB_misses", "branch_misses"};
+    return names[counter];
+  }
+
+  /**
+   * @return true if a counter could be opened
+   */
+  bool available(int counter) const {
+    return fd[counter] >= 0;
+  }
+
+  /**
+   * Reset and start all the counters.
+   */
+  void start() {
+    for(int i = 0; i < NB_COUNTERS; i++)
+      if(fd[i] >= 0) {
+        ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+  }
+
+  /**
+   * Stop all the counters and read their values.
+   */
+  void stop() {
+    for(int i = 0; i < NB_COUNTERS; i++)
+      if(fd[i] >= 0) ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+    for(int i = 0; i < NB_COUNTERS; i++) {
+      uint64_t data[3] = {0}; // value, time enabled, time running
+      if(fd[i] >= 0 && read(fd[i], data, sizeof(data)) == sizeof(data) && data[2])
+        values[i] = data[2] < data[1] ? uint64_t(double(data[0]) * data[1] / data[2]) : data[0];
+      else values[i] = 0;
+    }
+  }
+
+  /**
+   * @return value of a counter between the last calls to start and stop
+   */
+  uint64_t get(int counter) const {
+    return values[counter];
+  }
+
+  PerfCounters() {
+    static const uint32_t types[NB_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                                PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+    static const uint64_t configs[NB_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+      PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+      PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+      PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for(int i = 0; i < NB_COUNTERS; i++) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = types[i];
+      attr.config = configs[i];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1; // allowed with the default perf_event_paranoid setting
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0); // current thread, any CPU
+      values[i] = 0;
+    }
+  }
+
+  ~PerfCounters() {
+    for(int i = 0; i < NB_COUNTERS; i++)
+      if(fd[i] >= 0) close(fd[i]);
+  }
+
+ private:
+  int fd[NB_COUNTERS];
+  uint64_t values[NB_COUNTERS];
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
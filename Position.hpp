@@ -138,6 +138,22 @@ class Position {
   }
 
 
+  /**
+   * Indicates whether the current player can still make an alignment,
+   * that is if at least one line of four cells contains no opponent stone.
+   */
+  bool canStillAlign() const {
+    return has_alignment(board_mask & ~(current_position ^ mask));
+  }
+
+  /**
+   * Indicates whether the opponent can still make an alignment,
+   * that is if at least one line of four cells contains no current player stone.
+   */
+  bool opponentCanStillAlign() const {
+    return has_alignment(board_mask & ~current_position);
+  }
+
   /**
    * @return number of moves played from the beginning of the game.
    */
@@ -176,6 +192,24 @@ class Position {
     return key_forward < key_reverse ? key_forward / 3 : key_reverse / 3; // take the smallest key and divide per 3 as the last base3 digit is always 0
   }
 
+  /**
+   * Indicates whether the position is left-right symmetric.
+   * Column col and column WIDTH - 1 - col of a symmetric position have the same score.
+   */
+  bool isSymmetric() const {
+    const position_t k = key(); // each column of the key only depends on the content of the same column
+    for(int col = 0; col < WIDTH / 2; col++)
+      if(((k >> col * (HEIGHT + 1)) ^ (k >> (WIDTH - 1 - col) * (HEIGHT + 1))) & ((position_t(1) << (HEIGHT + 1)) - 1)) return false;
+    return true;
+  }
+
+  /**
+   * Number of threats of both players: empty cells completing an alignment.
+   */
+  int nbThreats() const {
+    return popcount(winning_position() | opponent_winning_position());
+  }
+
   /**
    * Return a bitmap of all the possible next moves the do not lose in one turn.
    * A losing move is a move leaving the possibility for the opponent to win directly.
@@ -209,6 +243,43 @@ class Position {
     return popcount(compute_winning_position(current_position | move, mask));
   }
 
+  /**
+   * Score a possible move by the opponent threats it blocks.
+   *
+   * @param move, a possible move given in a bitmap format.
+   *
+   * The score is the number of winning spots the opponent
+   * would have had if he had played this move himself.
+   */
+  int blockScore(position_t move) const {
+    return popcount(compute_winning_position((current_position ^ mask) | move, mask));
+  }
+
+  /**
+   * Score a possible move by the parity of the threats it creates.
+   *
+   * @param move, a possible move given in a bitmap format.
+   *
+   * The score is the number of winning spots the current player has after
+   * playing the move that lie on his favorable rows: odd rows (1st, 3rd, 5th)
+   * for the first player and even rows for the second player.
+   */
+  int parityScore(position_t move) const {
+    return popcount(compute_winning_position(current_position | move, mask) & (moves & 1 ? even_rows_mask : odd_rows_mask));
+  }
+
+  /**
+   * Score a possible move by the opponent threats it stacks under.
+   *
+   * @param move, a possible move given in a bitmap format.
+   *
+   * @return 1 if the cell two rows above the move is a winning spot of the opponent
+   * (the opponent could then get it after our next move in this column), 0 otherwise.
+   */
+  int underThreatScore(position_t move) const {
+    return popcount((opponent_winning_position() >> 2) & move & (board_mask >> 1));
+  }
+
   /**
    * Default constructor, build an empty position.
    */
@@ -233,6 +304,27 @@ class Position {
     play((mask + bottom_mask_col(col)) & column_mask(col));
   }
 
+  /**
+   * Indicates whether the last move can have been played in a column,
+   * that is whether the top stone of the column belongs to the previous player.
+   * @param col: 0-based index of column.
+   */
+  bool canUndo(int col) const {
+    return top_stone_col(col) & ~current_position;
+  }
+
+  /**
+   * Removes the top stone of a column, going back to a possible parent position.
+   * This function should only be called on a column for which canUndo is true.
+   *
+   * @param col: 0-based index of column.
+   */
+  void undoCol(int col) {
+    mask ^= top_stone_col(col);
+    current_position ^= mask;
+    moves--;
+  }
+
   /**
    * Indicates whether the current player wins by playing a given column.
    * This function should never be called on a non-playable column.
@@ -291,6 +383,30 @@ class Position {
     return c;
   }
 
+  /**
+   * @param cells, a bitmap of cells
+   * @return true if the bitmap contains four aligned cells
+   */
+  static bool has_alignment(position_t cells) {
+    // vertical
+    position_t m = cells & (cells >> 1);
+    if(m & (m >> 2)) return true;
+
+    // horizontal
+    m = cells & (cells >> (HEIGHT + 1));
+    if(m & (m >> (2 * (HEIGHT + 1)))) return true;
+
+    // diagonal 1
+    m = cells & (cells >> HEIGHT);
+    if(m & (m >> (2 * HEIGHT))) return true;
+
+    // diagonal 2
+    m = cells & (cells >> (HEIGHT + 2));
+    if(m & (m >> (2 * (HEIGHT + 2)))) return true;
+
+    return false;
+  }
+
   /**
    * @parmam position, a bitmap of the player to evaluate the winning pos
    * @param mask, a mask of the already played spots
@@ -335,11 +451,23 @@ class Position {
   static constexpr position_t bottom_mask = bottom<WIDTH, HEIGHT>::mask;
   static constexpr position_t board_mask = bottom_mask * ((1LL << HEIGHT) - 1);
 
+  // bitmaps of the odd rows (1st, 3rd, 5th,...) and even rows (2nd, 4th,...) counting from the bottom
+  template<int row, bool end = (row < 0)> struct alternate_rows {static constexpr position_t mask = alternate_rows<row - 2>::mask | bottom_mask << row;};
+  template<int row> struct alternate_rows<row, true> {static constexpr position_t mask = 0;};
+
+  static constexpr position_t odd_rows_mask = alternate_rows<(HEIGHT - 1) / 2 * 2>::mask;
+  static constexpr position_t even_rows_mask = board_mask & ~odd_rows_mask;
+
   // return a bitmask containg a single 1 corresponding to the top cel of a given column
   static constexpr position_t top_mask_col(int col) {
     return UINT64_C(1) << ((HEIGHT - 1) + col * (HEIGHT + 1));
   }
 
+  // return a bitmask containg a single 1 corresponding to the highest stone of a given column, or 0 if it is empty
+  position_t top_stone_col(int col) const {
+    return (((mask & column_mask(col)) + bottom_mask_col(col)) >> 1) & mask;
+  }
+
   // return a bitmask containg a single 1 corresponding to the bottom cell of a given column
   static constexpr position_t bottom_mask_col(int col) {
     return UINT64_C(1) << col * (HEIGHT + 1);
@@ -350,6 +478,9 @@ class Position {
   static constexpr position_t column_mask(int col) {
     return ((UINT64_C(1) << HEIGHT) - 1) << col * (HEIGHT + 1);
   }
+
+  // bitmask of the columns 0 to WIDTH/2, enough to explore all the moves of a symmetric position
+  static constexpr position_t left_half_mask = ((position_t(1) << (WIDTH + 1) / 2 * (HEIGHT + 1)) - 1) & board_mask;
 };
 
 } // namespace Connect4
@@ -0,0 +1,83 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Breakdown of the time spent by the solver in the different phases of negamax.
+ *
+ * Phases are only measured when the solver is compiled with SOLVER_PROFILE defined
+ * (see bench target of the Makefile), otherwise PROFILE_START and PROFILE_END are
+ * empty and profiling has no cost. Time is measured in CPU timestamp counter ticks
+ * (rdtsc) on x86, in nanoseconds otherwise.
+ */
+class Profiler {
+ public:
+  enum Phase {MOVE_GENERATION, TT_PROBE, BOOK_LOOKUP, MOVE_SORTING, NB_PHASES};
+
+  static const char* name(int phase) {
+    static const char* names[NB_PHASES] = {"move_generation", "tt_probe", "book_lookup", "move_sorting"};
+    return names[phase];
+  }
+
+  static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  void add(Phase phase, uint64_t start) {
+    time[phase] += ticks() - start;
+    calls[phase]++;
+  }
+
+  void reset() {
+    for(int i = 0; i < NB_PHASES; i++) time[i] = calls[i] = 0;
+  }
+
+  uint64_t time[NB_PHASES];  // ticks spent in each phase
+  uint64_t calls[NB_PHASES]; // number of measures of each phase
+
+  Profiler() {
+    reset();
+  }
+};
+
+#ifdef SOLVER_PROFILE
+#define PROFILE_START(t) const uint64_t t = Profiler::ticks()
+#define PROFILE_END(phase, t) profiler.add(Profiler::phase, t)
+#else
+#define PROFILE_START(t)
+#define PROFILE_END(phase, t)
+#endif
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -0,0 +1,93 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Difficulty-aware task queue shared by concurrent workers.
+ *
+ * Tasks are pushed with an estimated difficulty (see Solver::estimateDifficulty) and
+ * split in two FIFO queues: easy tasks below the threshold and hard tasks above it.
+ * Easy tasks are always served first so that cheap queries do not wait behind expensive ones.
+ * When some workers are dedicated to hard tasks, the other workers never take hard tasks
+ * and stay available for easy ones. Dedicated workers take easy tasks when there is no hard task.
+ *
+ * With the default infinite threshold, the scheduler is a plain FIFO queue.
+ */
+template<class task_t>
+class Scheduler {
+ public:
+  explicit Scheduler(double threshold = 1e300, int hard_workers = 0) : threshold{threshold}, hardWorkers{hard_workers} {}
+
+  // @return true if the task is queued as a hard one
+  bool push(task_t *t, double difficulty) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const bool hard = difficulty >= threshold;
+    (hard ? hardQueue : easyQueue).push_back(t);
+    ready.notify_all(); // workers are waiting for different queues
+    return hard;
+  }
+
+  // @param dedicated: true for a worker dedicated to hard tasks
+  // @return next task for the worker, or nullptr when the scheduler is closed and has no task for it
+  task_t *pop(bool dedicated) {
+    std::unique_lock<std::mutex> lock(mutex);
+    std::deque<task_t *> *queue;
+    ready.wait(lock, [&] {return (queue = next(dedicated)) || closed;});
+    if(!queue) return nullptr;
+    task_t *t = queue->front();
+    queue->pop_front();
+    return t;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    ready.notify_all();
+  }
+
+ private:
+  // queue the next task of a worker is taken from, or nullptr if there is none
+  std::deque<task_t *> *next(bool dedicated) {
+    if(dedicated && !hardQueue.empty()) return &hardQueue;
+    if(!easyQueue.empty()) return &easyQueue;
+    if(hardWorkers == 0 && !hardQueue.empty()) return &hardQueue;
+    return nullptr;
+  }
+
+  const double threshold;
+  const int hardWorkers;
+  std::deque<task_t *> easyQueue;
+  std::deque<task_t *> hardQueue;
+  std::mutex mutex;
+  std::condition_variable ready;
+  bool closed = false;
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -17,8 +17,13 @@
  */
 
 #include <cassert>
+#include <limits>
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
 #include "Solver.hpp"
 #include "MoveSorter.hpp"
+#include "DiskTranspositionTable.hpp"
 
 using namespace GameSolver::Connect4;
 
@@ -35,14 +40,25 @@ namespace Connect4 {
  * - if actual score of position <= alpha then actual score <= return value <= alpha
  * - if actual score of position >= beta then beta <= return value <= actual score
  * - if alpha <= actual score <= beta then return value = actual score
+ * @param with_extras: false for the plain search, ignoring all the optional features (see extras).
  */
-int Solver::negamax(const Position &P, int alpha, int beta) {
+template<bool with_extras> int Solver::negamax(const Position &P, int alpha, int beta) {
   assert(alpha < beta);
   assert(!P.canWinNext());
 
   nodeCount++; // increment counter of explored nodes
+  if(with_extras) {
+    if(nodeCount > nodeLimit) { // stop the search when the node budget is exhausted
+      aborted = true;
+      return alpha;
+    }
+    if(!(nodeCount & PERIODIC_NODES)) periodicTasks();
+  }
+  const unsigned long long first_node = nodeCount; // to compute the size of the explored subtree
 
+  PROFILE_START(generation_start);
   Position::position_t possible = P.possibleNonLosingMoves();
+  PROFILE_END(MOVE_GENERATION, generation_start);
   if(possible == 0)     // if no possible non losing move, opponent wins next move
     return -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
 
@@ -61,8 +77,27 @@ int Solver::negamax(const Position &P, int alpha, int beta) {
     if(alpha >= beta) return beta;  // prune the exploration if the [alpha;beta] window is empty.
   }
 
+  if(P.nbMoves() >= DEAD_POSITION_MOVES) {
+    if(!P.opponentCanStillAlign()) {  // opponent cannot win anymore, score is at least a draw
+      if(!P.canStillAlign()) return 0; // nobody can win anymore, the game is a draw
+      if(alpha < 0) {
+        alpha = 0;
+        if(alpha >= beta) return alpha;  // prune the exploration if the [alpha;beta] window is empty.
+      }
+    } else if(!P.canStillAlign()) {    // we cannot win anymore, score is at most a draw
+      if(beta > 0) {
+        beta = 0;
+        if(alpha >= beta) return beta;   // prune the exploration if the [alpha;beta] window is empty.
+      }
+    }
+  }
+
+  PROFILE_START(probe_start);
   const Position::position_t key = P.key();
-  if(int val = transTable.get(key)) {
+  int val = transTable.get(key);
+  if(with_extras && !val && P.nbMoves() <= diskDepth) val = diskTable->get(key); // second tier table is only probed at shallow depth
+  PROFILE_END(TT_PROBE, probe_start);
+  if(val) {
     if(val > Position::MAX_SCORE - Position::MIN_SCORE + 1) { // we have an lower bound
       min = val + 2 * Position::MIN_SCORE - Position::MAX_SCORE - 2;
       if(alpha < min) {
@@ -78,72 +113,782 @@ int Solver::negamax(const Position &P, int alpha, int beta) {
     }
   }
 
-  if(int val = book.get(P)) return val + Position::MIN_SCORE - 1; // look for solutions stored in opening book
+  if(with_extras && P.nbMoves() <= learnedDepth) {
+    int learned_min, learned_max;
+    if(learnedBook.get(key, learned_min, learned_max)) { // bounds recorded by previous expensive searches
+      if(alpha < learned_min && (alpha = learned_min) >= beta) return alpha;
+      if(beta > learned_max && alpha >= (beta = learned_max)) return beta;
+    }
+  }
+
+  PROFILE_START(book_start);
+  val = book.get(P);
+  PROFILE_END(BOOK_LOOKUP, book_start);
+  if(val) return val + Position::MIN_SCORE - 1; // look for solutions stored in opening book
 
+  PROFILE_START(sorting_start);
   MoveSorter moves;
-  for(int i = Position::WIDTH; i--;)
-    if(Position::position_t move = possible & Position::column_mask(columnOrder[i]))
-      moves.add(move, P.moveScore(move));
+  const int nb_moves = sortMoves<with_extras>(P, possible, moves);
+  PROFILE_END(MOVE_SORTING, sorting_start);
 
-  while(Position::position_t next = moves.getNext()) {
+  const int frame = P.nbMoves() - progressRoot + 1; // progress frame tracking the moves of this position
+  const bool tracked = with_extras && progressRoot >= 0 && frame < PROGRESS_DEPTH;
+  if(tracked) setProgress(frame, 0, nb_moves);
+
+  for(int explored = 0; Position::position_t next = moves.getNext();) {
     Position P2(P);
     P2.play(next);  // It's opponent turn in P2 position after current player plays x column.
-    int score = -negamax(P2, -beta, -alpha); // explore opponent's score within [-beta;-alpha] windows:
+    int score;
+    if(with_extras && P2.nbMoves() <= remoteDepth && remoteSearch(P2, -beta, -alpha, score)) score = -score; // searched by another process
+    else score = -negamax<with_extras>(P2, -beta, -alpha); // explore opponent's score within [-beta;-alpha] windows:
     // no need to have good precision for score better than beta (opponent's score worse than -beta)
     // no need to check for score worse than alpha (opponent's score worse better than -alpha)
+    if(with_extras) {
+      if(aborted) return alpha; // search stopped by the node budget: score is meaningless and must not be stored
+      if(tracked) setProgress(frame, ++explored, nb_moves);
+      if(P.nbMoves() == checkpointRoot) // keep the results of the root moves for the checkpoints
+        if(uint8_t val = transTable.get(P2.key())) checkpointEntries.push_back(std::make_pair(P2.key(), val));
+    }
 
     if(score >= beta) {
-      transTable.put(key, score + Position::MAX_SCORE - 2 * Position::MIN_SCORE + 2); // save the lower bound of the position
+      store<with_extras>(P, key, score + Position::MAX_SCORE - 2 * Position::MIN_SCORE + 2, nodeCount - first_node + 1); // save the lower bound of the position
       return score;  // prune the exploration if we find a possible move better than what we were looking for.
     }
     if(score > alpha) alpha = score; // reduce the [alpha;beta] window for next exploration, as we only
     // need to search for a position that is better than the best so far.
   }
 
-  transTable.put(key, alpha - Position::MIN_SCORE + 1); // save the upper bound of the position
+  store<with_extras>(P, key, alpha - Position::MIN_SCORE + 1, nodeCount - first_node + 1); // save the upper bound of the position
   return alpha;
 }
 
+int Solver::searchWindow(const Position &P, int alpha, int beta) {
+  if(P.canWinNext()) return (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+  return negamax(P, alpha, beta);
+}
+
+template<bool with_extras> int Solver::sortMoves(const Position &P, Position::position_t possible, MoveSorter &moves) const {
+  if(P.nbMoves() < SYMMETRY_MOVES && P.isSymmetric()) possible &= Position::left_half_mask; // mirror moves have the same score, only explore the left half
+  int nb_moves = 0;
+  if(!with_extras) { // plain search with the default move ordering
+    for(int i = Position::WIDTH; i--;)
+      if(Position::position_t move = possible & Position::column_mask(columnOrder[i])) {
+        moves.add(move, P.moveScore(move));
+        nb_moves++;
+      }
+    return nb_moves;
+  }
+  const bool costs = P.nbMoves() < costOrderingDepth; // only enabled with the subtree sizes
+  for(int i = Position::WIDTH; i--;)
+    if(Position::position_t move = possible & Position::column_mask(columnOrder[i])) {
+      if(costs) { // on equal scores, children with larger known subtrees are explored first
+        Position P2(P);
+        P2.play(move);
+        moves.add(move, ordering.score(P, move, columnOrder[i]) * 128 + transTable.getCost(P2.key()));
+      }
+      else moves.add(move, ordering.score(P, move, columnOrder[i]));
+      nb_moves++;
+    }
+  return nb_moves;
+}
+
+/**
+ * Store the bound of a position in the transposition table, and also in the disk
+ * transposition table and the learned book if the position is shallow and expensive enough.
+ * @param P: position
+ * @param key: key of the position
+ * @param value: value encoding the bound of the position
+ * @param nodes: size of the subtree explored to compute the bound
+ * @param with_extras: false to only use the transposition table, when no optional feature is enabled.
+ */
+template<bool with_extras> void Solver::store(const Position &P, Position::position_t key, uint8_t value, unsigned long long nodes) {
+  if(!with_extras) { // plain search
+    transTable.put(key, value);
+    return;
+  }
+  if(transTable.hasCosts()) transTable.put(key, value, 64 - __builtin_clzll(nodes)); // log2 of the subtree size
+  else transTable.put(key, value);
+  if(P.nbMoves() <= diskDepth && nodes >= diskMinNodes) diskTable->put(key, value);
+  if(P.nbMoves() <= learnedDepth && nodes >= learnedMinNodes) {
+    if(value > Position::MAX_SCORE - Position::MIN_SCORE + 1) // lower bound
+      learnedBook.put(key, value + 2 * Position::MIN_SCORE - Position::MAX_SCORE - 2, Position::MAX_SCORE);
+    else learnedBook.put(key, Position::MIN_SCORE, value + Position::MIN_SCORE - 1); // upper bound
+  }
+}
+
+bool Solver::enableDiskTable(const std::string &file, int log_size, int max_depth, unsigned long long min_nodes) {
+  diskDepth = -1;
+  if(!diskTable) diskTable = new DiskTranspositionTable<Position::position_t, uint8_t>(Position::WIDTH, Position::HEIGHT, Position::MIN_SCORE, Position::MAX_SCORE);
+  if(!diskTable->open(file, log_size)) {
+    updateExtras();
+    return false;
+  }
+  diskDepth = max_depth;
+  diskMinNodes = min_nodes;
+  updateExtras();
+  return true;
+}
+
 int Solver::solve(const Position &P, bool weak) {
-  if(P.canWinNext()) // check if win in one move as the Negamax function does not support this case.
-    return (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
-  int min = -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
-  int max = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+  int min, max;
+  solve(P, weak, std::numeric_limits<unsigned long long>::max(), min, max);
+  return min;
+}
+
+bool Solver::solve(const Position &P, bool weak, unsigned long long max_nodes, int &min, int &max) {
+  if(P.canWinNext()) { // check if win in one move as the Negamax function does not support this case.
+    min = max = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+    return true;
+  }
+  min = -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
+  max = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
   if(weak) {
     min = -1;
     max = 1;
   }
+  nodeLimit = max_nodes < std::numeric_limits<unsigned long long>::max() - nodeCount ?
+              nodeCount + max_nodes : std::numeric_limits<unsigned long long>::max();
+  updateExtras();
+  narrow(P, min, max);
+  nodeLimit = std::numeric_limits<unsigned long long>::max();
+  aborted = false;
+  updateExtras();
+  return min == max;
+}
 
+int Solver::solveWithHint(const Position &P, int min, int max) {
+  assert(min <= max);
+  int score;
+  if(P.canWinNext()) // check if win in one move as the Negamax function does not support this case.
+    score = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+  else {
+    int lower = min, upper = max;
+    narrow(P, lower, upper);
+    score = lower;
+  }
+  return score < min ? min : score > max ? max : score; // closest bound when the score is outside of the hint
+}
+
+bool Solver::scoreAtLeast(const Position &P, int threshold) {
+  if(P.canWinNext()) // check if win in one move as the Negamax function does not support this case.
+    return (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2 >= threshold;
+  int score = bookScore(P);
+  if(score != Solver::INVALID_MOVE) return score >= threshold;
+  return negamax(P, threshold - 1, threshold) >= threshold; // single null window search
+}
+
+/**
+ * Iteratively narrow the interval containing the score of a position with null window searches.
+ * @param P: position to solve, current player cannot win next move.
+ * @param min, max: interval known to contain the score, on return [min;max] is the narrowed interval.
+ *        It is a single value unless the search was stopped by nodeLimit.
+ *        If the actual score is below the initial interval, min is found. If it is above, the value found
+ *        is a lower bound of the score greater than max (weak solve relies on this to return such bounds).
+ */
+void Solver::narrow(const Position &P, int &min, int &max) {
+  Tracer::Span span(tracer, "solve", "narrow");
+  int score = bookScore(P);
+  if(score != Solver::INVALID_MOVE) { // answer positions inside the opening book without any search
+    min = max = score < min ? min : score; // as found by a search
+    return;
+  }
+
+  int lowest = -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;   // proven interval of the score of the position
+  int highest = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+
+  const bool checkpointing = !checkpointFile.empty() && checkpointRoot < 0;
+  if(checkpointing) {
+    if(checkpointResume) loadCheckpoint(P, lowest, highest);
+    checkpointRoot = P.nbMoves();
+    updateExtras();
+    checkpointPosition = P;
+    checkpointMin = &lowest;
+    checkpointMax = &highest;
+    checkpointLast = std::chrono::steady_clock::now();
+  }
+
+  // Positions just beyond the opening book usually have the same score than their ancestors:
+  // when possible, the null window is first chosen to check whether the position has the median score of its
+  // nearest ancestors. Each parent also gives a proven lower bound as the position is one of its children.
+  int guess = Solver::INVALID_MOVE;
+  if(book.getDepth() >= 0 && P.nbMoves() > book.getDepth() && P.nbMoves() <= book.getDepth() + BOOK_GUESS_PLIES) {
+    std::map<Position::position_t, int> ancestors;
+    bookAncestors(P, P.nbMoves() - book.getDepth(), 1, ancestors);
+    if(!ancestors.empty()) {
+      std::vector<int> scores;
+      for(const auto &a : ancestors) scores.push_back(a.second);
+      std::sort(scores.begin(), scores.end());
+      guess = scores[scores.size() / 2];
+      if(P.nbMoves() == book.getDepth() + 1 && scores.back() > lowest) lowest = scores.back();
+    }
+  }
+
+  if(max > highest) max = highest < min ? min : highest; // keep only possible scores, or the closest bound
+  if(min < lowest) min = lowest; // if the score is above the interval (weak solve),
+  if(max < min) max = min;       // the proven lower bound is the value found
+
+  if(guess != Solver::INVALID_MOVE) {
+    if(guess > max) guess = max; // weak mode only checks the sign of the score
+    if(guess < min) guess = min;
+  }
+
+  const bool tracking = startProgress(P.nbMoves());
+  int iterations = 0;
   while(min < max) {                    // iteratively narrow the min-max exploration window
+    if(tracking) {
+      int remaining = 0;                // expected number of remaining iterations
+      for(int r = max - min + 1; r > 1; r = (r + 1) / 2) remaining++;
+      setProgress(0, iterations, iterations + remaining);
+      iterations++;
+    }
+    if(checkpointing) checkpointEntries.clear();
     int med = min + (max - min) / 2;
     if(med <= 0 && min / 2 < med) med = min / 2;
     else if(med >= 0 && max / 2 > med) med = max / 2;
+    if(guess != Solver::INVALID_MOVE) {
+      int g = guess;                     // check if score <= guess
+      if(g < min || g >= max) g--;       // otherwise check if score >= guess
+      if(g >= min && g < max) med = g;
+    }
+    Tracer::Span iteration(tracer, "solve", "iteration");
+    iteration.arg("med", med);
     int r = negamax(P, med, med + 1);   // use a null depth window to know if the actual score is greater or smaller than med
-    if(r <= med) max = r;
-    else min = r;
+    iteration.arg("result", r);
+    if(aborted) break;                  // node budget exhausted: [min;max] is the interval proven so far
+    if(r <= med) max = highest = r;
+    else min = lowest = r;
   }
-  return min;
+  if(max < min) max = min; // the score is outside the initial interval
+  if(tracking) progressRoot = -1;
+  if(checkpointing) checkpointRoot = -1;
+  updateExtras();
+  span.arg("moves", P.nbMoves());
+  span.arg("min", min);
+  span.arg("max", max);
+}
+
+void Solver::bookAncestors(Position P, int plies, int sign, std::map<Position::position_t, int> &scores) const {
+  if(plies == 0) {
+    int score = bookScore(P);
+    if(score != Solver::INVALID_MOVE) scores[P.key3()] = sign * score;
+    return;
+  }
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(P.canUndo(col)) {
+      Position P2(P);
+      P2.undoCol(col);
+      bookAncestors(P2, plies - 1, -sign, scores);
+    }
 }
 
-std::vector<int> Solver::analyze(const Position &P, bool weak) {
+/**
+ * Save the state of the position being narrowed to the checkpoint file.
+ * The file is written under a temporary name and renamed, so that an interruption
+ * while saving never corrupts the previous checkpoint.
+ *
+ * Checkpoint file format:
+ * - 1 byte: board width
+ * - 1 byte: board height
+ * - 1 byte: log2 of the transposition table size
+ * - key of the position being narrowed (sizeof(Position::position_t) bytes)
+ * - int: number of moves of the position
+ * - int, int: proven interval of the score of the position
+ * - unsigned long long: node count
+ * - int: number of explored moves of the root position in the current iteration
+ * - for each of these moves: its key and its transposition table value
+ * - transposition table content
+ */
+void Solver::saveCheckpoint() {
+  Tracer::Span span(tracer, "checkpoint", "save");
+  std::string tmp_file = checkpointFile + ".tmp";
+  std::ofstream ofs(tmp_file, std::ios::binary);
+  char header[3] = {Position::WIDTH, Position::HEIGHT, TABLE_SIZE};
+  ofs.write(header, 3);
+  Position::position_t key = checkpointPosition.key();
+  int moves = checkpointPosition.nbMoves();
+  int nb_entries = checkpointEntries.size();
+  ofs.write(reinterpret_cast<const char *>(&key), sizeof(key));
+  ofs.write(reinterpret_cast<const char *>(&moves), sizeof(moves));
+  ofs.write(reinterpret_cast<const char *>(checkpointMin), sizeof(int));
+  ofs.write(reinterpret_cast<const char *>(checkpointMax), sizeof(int));
+  ofs.write(reinterpret_cast<const char *>(&nodeCount), sizeof(nodeCount));
+  ofs.write(reinterpret_cast<const char *>(&nb_entries), sizeof(nb_entries));
+  for(const std::pair<Position::position_t, uint8_t> &entry : checkpointEntries) {
+    ofs.write(reinterpret_cast<const char *>(&entry.first), sizeof(entry.first));
+    ofs.write(reinterpret_cast<const char *>(&entry.second), sizeof(entry.second));
+  }
+  bool saved = transTable.save(ofs);
+  ofs.close();
+  if(!saved || ofs.fail() || std::rename(tmp_file.c_str(), checkpointFile.c_str()))
+    std::cerr << "Unable to save checkpoint: " << checkpointFile << std::endl;
+  checkpointLast = std::chrono::steady_clock::now();
+}
+
+/**
+ * Restore the state saved in the checkpoint file, if it was saved while narrowing the given position.
+ * @param P: position to narrow.
+ * @param lowest, highest: proven interval of the score, intersected with the saved one.
+ * @return true if the checkpoint was restored.
+ */
+bool Solver::loadCheckpoint(const Position &P, int &lowest, int &highest) {
+  std::ifstream ifs(checkpointFile, std::ios::binary);
+  if(ifs.fail()) return false;
+  char header[3];
+  Position::position_t key;
+  int moves, min, max, nb_entries;
+  unsigned long long nodes;
+  ifs.read(header, 3);
+  ifs.read(reinterpret_cast<char *>(&key), sizeof(key));
+  ifs.read(reinterpret_cast<char *>(&moves), sizeof(moves));
+  if(ifs.fail() || header[0] != Position::WIDTH || header[1] != Position::HEIGHT || header[2] != TABLE_SIZE
+      || key != P.key() || moves != P.nbMoves()) return false; // checkpoint of another position
+  ifs.read(reinterpret_cast<char *>(&min), sizeof(min));
+  ifs.read(reinterpret_cast<char *>(&max), sizeof(max));
+  ifs.read(reinterpret_cast<char *>(&nodes), sizeof(nodes));
+  ifs.read(reinterpret_cast<char *>(&nb_entries), sizeof(nb_entries));
+  std::vector<std::pair<Position::position_t, uint8_t>> entries(ifs.fail() || nb_entries < 0 ? 0 : nb_entries);
+  for(std::pair<Position::position_t, uint8_t> &entry : entries) {
+    ifs.read(reinterpret_cast<char *>(&entry.first), sizeof(entry.first));
+    ifs.read(reinterpret_cast<char *>(&entry.second), sizeof(entry.second));
+  }
+  if(ifs.fail() || !transTable.load(ifs)) {
+    std::cerr << "Unable to resume from checkpoint: " << checkpointFile << std::endl;
+    transTable.reset(); // table may be partially overwritten
+    return false;
+  }
+  for(const std::pair<Position::position_t, uint8_t> &entry : entries) transTable.put(entry.first, entry.second);
+  if(min > lowest) lowest = min;
+  if(max < highest) highest = max;
+  nodeCount = nodes;
+  std::cerr << "Resuming from checkpoint: " << checkpointFile << std::endl;
+  return true;
+}
+
+std::vector<int> Solver::analyze(const Position &P, bool weak, AnalyzeCallback callback) {
+  Tracer::Span span(tracer, "analyze", "analyze");
   std::vector<int> scores(Position::WIDTH, Solver::INVALID_MOVE);
+  Position children[Position::WIDTH];
+  int min[Position::WIDTH], max[Position::WIDTH]; // proven interval of the score of each child (from the opponent point of view)
+
+  int best = Solver::INVALID_MOVE; // best column already proven
+  auto proven = [&](int col, int score) {
+    scores[col] = score;
+    if(best == Solver::INVALID_MOVE || score > scores[best]) best = col;
+    if(callback) callback(col, score, best);
+  };
+
   for (int col = 0; col < Position::WIDTH; col++)
     if (P.canPlay(col)) {
-      if(P.isWinningMove(col)) scores[col] = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+      if(P.isWinningMove(col)) proven(col, (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2);
       else {
-        Position P2(P);
-        P2.playCol(col);
-        scores[col] = -solve(P2, weak);
+        children[col] = P;
+        children[col].playCol(col);
+        if(children[col].canWinNext()) { // opponent wins next move
+          min[col] = max[col] = (Position::WIDTH * Position::HEIGHT + 1 - children[col].nbMoves()) / 2;
+        } else if(weak) {
+          min[col] = -1;
+          max[col] = 1;
+        } else {
+          min[col] = -(Position::WIDTH * Position::HEIGHT - children[col].nbMoves()) / 2;
+          max[col] = (Position::WIDTH * Position::HEIGHT + 1 - children[col].nbMoves()) / 2;
+        }
+        int score = bookScore(children[col]); // children inside the opening book are not searched
+        if(score != Solver::INVALID_MOVE && min[col] < max[col])
+          min[col] = max[col] = score < min[col] ? min[col] : score;
       }
     }
+  for(int col = 0; col < Position::WIDTH; col++) // children already solved are given at once
+    if(scores[col] == Solver::INVALID_MOVE && P.canPlay(col) && min[col] == max[col]) proven(col, -min[col]);
+
+  // Children are narrowed one after the other in the column exploration order, sharing the same transposition table.
+  // Sibling scores are good guesses: when possible, the null window is chosen to check whether
+  // the child has the same score than the best already solved sibling whose score is still possible.
+  bool solved[Position::WIDTH] = {false};
+  const bool tracking = startProgress(P.nbMoves() + 1);
+  const bool symmetric = P.isSymmetric(); // mirror moves have the same score and are only solved once
+  int nb_solved = 0, nb_children = 0;
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(P.canPlay(col) && !P.isWinningMove(col) && !(symmetric && col > Position::WIDTH - 1 - col)) nb_children++;
+
+  for(int i = 0; i < Position::WIDTH; i++) {
+    int col = columnOrder[i];
+    if(!P.canPlay(col) || P.isWinningMove(col)) continue;
+    if(symmetric && col > Position::WIDTH - 1 - col) continue;
+    if(tracking) setProgress(0, nb_solved++, nb_children);
+    Tracer::Span root_move(tracer, "analyze", "root move");
+    root_move.arg("column", col);
+    while(min[col] < max[col]) {
+      int med = min[col] + (max[col] - min[col]) / 2;
+      if(med <= 0 && min[col] / 2 < med) med = min[col] / 2;
+      else if(med >= 0 && max[col] / 2 > med) med = max[col] / 2;
+      int guess = Solver::INVALID_MOVE;
+      for(int sibling = 0; sibling < Position::WIDTH; sibling++)
+        if(solved[sibling]) {
+          int g = min[sibling];                  // check if score <= sibling score
+          if(g < min[col] || g >= max[col]) g--; // otherwise check if score >= sibling score
+          if(g >= min[col] && g < max[col] && (guess == Solver::INVALID_MOVE || g < guess)) guess = g;
+        }
+      if(guess != Solver::INVALID_MOVE) med = guess;
+      int r = negamax(children[col], med, med + 1); // use a null depth window to know if the actual score is greater or smaller than med
+      if(r <= med) max[col] = r;
+      else min[col] = r;
+    }
+    solved[col] = true;
+    if(scores[col] != Solver::INVALID_MOVE) continue; // already given before the search
+    proven(col, -min[col]);
+    if(symmetric && col != Position::WIDTH - 1 - col) proven(Position::WIDTH - 1 - col, -min[col]);
+  }
+  if(tracking) progressRoot = -1;
+  updateExtras();
+  return scores;
+}
+
+/**
+ * State of a search of the batch engine: the negamax calls are replaced by an explicit stack of
+ * frames, so that the search can be suspended while the transposition table entry of a position
+ * is prefetched, and resumed later.
+ */
+struct Solver::BatchSearch {
+  struct Frame {
+    enum Stage {ENTER, PROBE, CHILDREN};
+    Position P;
+    Position::position_t key;
+    Position::position_t possible;
+    MoveSorter moves;
+    unsigned long long first_node;
+    int alpha, beta;
+    Stage stage;
+  };
+  Frame stack[Position::WIDTH * Position::HEIGHT + 1];
+  int depth;                // number of frames, 0 when no search is running
+  int value;                // score returned by the root frame
+  unsigned long long nodes; // number of nodes explored by this search
+  size_t index;             // index of the solved position
+  int min, max, med;        // current window of the iterative narrowing of the score
+
+  // call negamax(P, alpha, beta)
+  void call(const Position &P, int alpha, int beta) {
+    Frame &f = stack[depth++];
+    f.P = P;
+    f.alpha = alpha;
+    f.beta = beta;
+    f.stage = Frame::ENTER;
+    f.moves.reset();
+  }
+
+  // start a null window search of the root position to know if its score is greater or smaller than med
+  void narrow(const Position &P) {
+    med = min + (max - min) / 2;
+    if(med <= 0 && min / 2 < med) med = min / 2;
+    else if(med >= 0 && max / 2 > med) med = max / 2;
+    call(P, med, med + 1);
+  }
+};
+
+/**
+ * Run a search of the batch engine until it needs a transposition table entry or its root frame returns.
+ * This is the same algorithm as negamax.
+ * @return true when the root frame returned, its score is then in s.value.
+ */
+bool Solver::step(BatchSearch &s) {
+  // return a score from the top frame to its parent, and so on while the parent returns too
+  auto unwind = [&](int value) {
+    for(;;) {
+      if(--s.depth == 0) {
+        s.value = value;
+        return true;
+      }
+      BatchSearch::Frame &f = s.stack[s.depth - 1];
+      const int score = -value;
+      if(score >= f.beta) {
+        store(f.P, f.key, score + Position::MAX_SCORE - 2 * Position::MIN_SCORE + 2, s.nodes - f.first_node + 1); // save the lower bound of the position
+        value = score;
+        continue;
+      }
+      if(score > f.alpha) f.alpha = score;
+      return false;
+    }
+  };
+
+  for(;;) {
+    BatchSearch::Frame &f = s.stack[s.depth - 1];
+    const Position &P = f.P;
+    if(f.stage == BatchSearch::Frame::ENTER) {
+      nodeCount++;
+      f.first_node = ++s.nodes;
+      f.possible = P.possibleNonLosingMoves();
+      if(f.possible == 0) { // if no possible non losing move, opponent wins next move
+        if(unwind(-(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2)) return true;
+        continue;
+      }
+      if(P.nbMoves() >= Position::WIDTH * Position::HEIGHT - 2) { // check for draw game
+        if(unwind(0)) return true;
+        continue;
+      }
+      int bound = Solver::INVALID_MOVE; // returned bound when the [alpha;beta] window becomes empty
+      int min = -(Position::WIDTH * Position::HEIGHT - 2 - P.nbMoves()) / 2;
+      if(f.alpha < min && (f.alpha = min) >= f.beta) bound = f.alpha;
+      int max = (Position::WIDTH * Position::HEIGHT - 1 - P.nbMoves()) / 2;
+      if(bound == Solver::INVALID_MOVE && f.beta > max && f.alpha >= (f.beta = max)) bound = f.beta;
+      if(bound == Solver::INVALID_MOVE && P.nbMoves() >= DEAD_POSITION_MOVES) {
+        if(!P.opponentCanStillAlign()) {
+          if(!P.canStillAlign()) bound = 0; // nobody can win anymore, the game is a draw
+          else if(f.alpha < 0 && (f.alpha = 0) >= f.beta) bound = f.alpha;
+        } else if(!P.canStillAlign() && f.beta > 0 && f.alpha >= (f.beta = 0)) bound = f.beta;
+      }
+      if(bound != Solver::INVALID_MOVE) {
+        if(unwind(bound)) return true;
+        continue;
+      }
+      f.key = P.key();
+      transTable.prefetch(f.key);
+      f.stage = BatchSearch::Frame::PROBE;
+      return false; // let the other searches run while the entry is loaded
+    }
+
+    if(f.stage == BatchSearch::Frame::PROBE) {
+      if(int val = transTable.get(f.key)) {
+        int bound = Solver::INVALID_MOVE;
+        if(val > Position::MAX_SCORE - Position::MIN_SCORE + 1) { // we have an lower bound
+          int min = val + 2 * Position::MIN_SCORE - Position::MAX_SCORE - 2;
+          if(f.alpha < min && (f.alpha = min) >= f.beta) bound = f.alpha;
+        } else { // we have an upper bound
+          int max = val + Position::MIN_SCORE - 1;
+          if(f.beta > max && f.alpha >= (f.beta = max)) bound = f.beta;
+        }
+        if(bound != Solver::INVALID_MOVE) {
+          if(unwind(bound)) return true;
+          continue;
+        }
+      }
+      if(int val = book.get(P)) { // look for solutions stored in opening book
+        if(unwind(val + Position::MIN_SCORE - 1)) return true;
+        continue;
+      }
+      sortMoves(P, f.possible, f.moves);
+      f.stage = BatchSearch::Frame::CHILDREN;
+    }
+
+    if(Position::position_t next = f.moves.getNext()) { // explore next child within [-beta;-alpha]
+      Position P2(P);
+      P2.play(next);
+      s.call(P2, -f.beta, -f.alpha);
+    } else {
+      store(P, f.key, f.alpha - Position::MIN_SCORE + 1, s.nodes - f.first_node + 1); // save the upper bound of the position
+      if(unwind(f.alpha)) return true;
+    }
+  }
+}
+
+std::vector<int> Solver::solveBatch(const std::vector<Position> &positions, bool weak, int lanes) {
+  std::vector<int> scores(positions.size());
+  std::vector<BatchSearch> searches(lanes < 1 ? 1 : lanes);
+  size_t next = 0;
+
+  // start the search of the next position that is not trivial, @return false if there is none
+  auto start = [&](BatchSearch &s) {
+    for(; next < positions.size(); next++) {
+      const Position &P = positions[next];
+      if(P.canWinNext()) {
+        scores[next] = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+        continue;
+      }
+      s.min = weak ? -1 : -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
+      s.max = weak ? 1 : (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+      int score = bookScore(P);
+      if(score != Solver::INVALID_MOVE) {
+        scores[next] = score < s.min ? s.min : score;
+        continue;
+      }
+      s.index = next++;
+      s.depth = 0;
+      s.nodes = 0;
+      s.narrow(P);
+      return true;
+    }
+    return false;
+  };
+
+  int running = 0;
+  for(BatchSearch &s : searches)
+    if(start(s)) running++;
+    else s.depth = 0;
+  while(running)
+    for(BatchSearch &s : searches)
+      if(s.depth && step(s)) { // the null window search of the root position is finished
+        if(s.value <= s.med) s.max = s.value;
+        else s.min = s.value;
+        if(s.min < s.max) s.narrow(positions[s.index]);
+        else {
+          scores[s.index] = s.min;
+          if(!start(s)) running--;
+        }
+      }
   return scores;
 }
 
+double Solver::estimateDifficulty(const Position &P) const {
+  if(P.nbMoves() <= book.getDepth() || P.canWinNext()) return 0;
+  double d = 0.5 * (Position::WIDTH * Position::HEIGHT - P.nbMoves()) - 2.5 * P.nbThreats(); // fitted on random positions
+  return d > 0 ? d : 0;
+}
+
+int Solver::bestMove(const Position &P, bool weak) {
+  Tracer::Span span(tracer, "bestMove", "bestMove");
+  for(int i = 0; i < Position::WIDTH; i++) // check for immediate win first
+    if(P.canPlay(columnOrder[i]) && P.isWinningMove(columnOrder[i])) return columnOrder[i];
+
+  Position::position_t possible = P.possibleNonLosingMoves();
+  if(possible == 0) { // every move loses, any playable column is optimal
+    for(int i = 0; i < Position::WIDTH; i++)
+      if(P.canPlay(columnOrder[i])) return columnOrder[i];
+    return INVALID_MOVE;
+  }
+  if(P.isSymmetric()) possible &= Position::left_half_mask; // mirror moves have the same score
+
+  if(P.nbMoves() < book.getDepth()) { // all the children are inside the opening book
+    int best_col = INVALID_MOVE, best_score = 0;
+    for(int i = 0; i < Position::WIDTH; i++)
+      if(possible & Position::column_mask(columnOrder[i])) {
+        Position P2(P);
+        P2.playCol(columnOrder[i]);
+        int score = bookScore(P2);
+        if(score == INVALID_MOVE) {       // not expected with a complete book, fall back to the search
+          best_col = INVALID_MOVE;
+          break;
+        }
+        if(best_col == INVALID_MOVE || -score > best_score) {
+          best_col = columnOrder[i];
+          best_score = -score;
+        }
+      }
+    if(best_col != INVALID_MOVE) return best_col;
+  }
+
+  MoveSorter moves;
+  int nb_moves = 0;
+  for(int i = Position::WIDTH; i--;)
+    if(Position::position_t move = possible & Position::column_mask(columnOrder[i])) {
+      moves.add(move, ordering.score(P, move, columnOrder[i]));
+      nb_moves++;
+    }
+
+  const bool tracking = startProgress(P.nbMoves() + 1);
+  int explored = 0;
+  int max = weak ? 1 : (Position::WIDTH * Position::HEIGHT - 1 - P.nbMoves()) / 2; // best possible score as we cannot win immediately
+  int best_col = INVALID_MOVE;
+  int best_score = 0;
+  while(Position::position_t next = moves.getNext()) {
+    if(tracking) setProgress(0, explored++, nb_moves);
+    Tracer::Span root_move(tracer, "bestMove", "root move");
+    Position P2(P);
+    P2.play(next);
+    if(best_col == INVALID_MOVE) {                     // most promising move is solved exactly
+      best_score = -solve(P2, weak);
+    } else if(negamax(P2, -best_score - 1, -best_score) <= -best_score - 1) { // null window check that this move is better
+      best_score = -solve(P2, weak);
+    } else continue;
+    for(best_col = 0; !(next & Position::column_mask(best_col)); best_col++); // retrieve column from move bitmap
+    if(best_score >= max) break;  // no need to check other moves if we already have the best possible score
+  }
+  if(tracking) progressRoot = -1;
+  updateExtras();
+  return best_col;
+}
+
+/**
+ * Start tracking progress of a search if a callback is defined and no search is already tracked.
+ * @param root: number of moves of the positions explored by the driver.
+ * @return true if the caller is the driver of the tracked search and has to stop tracking
+ *         at the end of the search by setting progressRoot to -1.
+ */
+bool Solver::startProgress(int root) {
+  if(!progressCallback || progressRoot >= 0) return false;
+  progressRoot = root;
+  updateExtras();
+  progressStart = progressLast = std::chrono::steady_clock::now();
+  progressDone = 0;
+  setProgress(0, 0, 1);
+  return true;
+}
+
+/**
+ * Update a progress frame and make it the deepest active frame
+ * @param frame: index of the frame
+ * @param done: number of fully explored subtrees of the frame, 0 to start a new frame
+ * @param total: total number of subtrees of the frame
+ */
+void Solver::setProgress(int frame, int done, int total) {
+  if(done == 0) progress[frame].start = nodeCount;
+  progress[frame].done = done;
+  progress[frame].total = total;
+  progress[frame].childStart = nodeCount;
+  progressDepth = frame + 1;
+}
+
+/**
+ * Recompute extras after an optional feature of the search has been enabled or disabled.
+ */
+void Solver::updateExtras() {
+  extras = nodeLimit != std::numeric_limits<unsigned long long>::max() || progressRoot >= 0 || checkpointRoot >= 0 ||
+           diskDepth >= 0 || learnedDepth >= 0 || remoteDepth >= 0 || transTable.hasCosts() || !ordering.isDefault();
+}
+
+/**
+ * Tasks done every PERIODIC_NODES nodes: progress report and checkpoint.
+ */
+void Solver::periodicTasks() {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if(progressRoot >= 0 && std::chrono::duration<double>(now - progressLast).count() >= progressInterval) {
+    progressLast = now;
+    reportProgress();
+  }
+  if(checkpointRoot >= 0 && std::chrono::duration<double>(now - checkpointLast).count() >= checkpointInterval)
+    saveCheckpoint();
+}
+
+/**
+ * Estimate the progress of the search and give it to the callback.
+ */
+void Solver::reportProgress() {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  double fraction = 0; // estimated fraction done of the current subtree of the deeper frame
+  for(int d = progressDepth; --d > 0;) // moves of the search tree: subtrees have the same weight
+    fraction = progress[d].done < progress[d].total ? (progress[d].done + fraction) / progress[d].total : 1;
+
+  // tasks of the driver: weighted by their node counts
+  double done_nodes = progress[0].childStart - progress[0].start; // nodes of the finished tasks
+  double current_nodes = nodeCount - progress[0].childStart;      // nodes already explored in the current task
+  double current_total = fraction > 0 ? current_nodes / fraction : current_nodes; // estimated size of the current task
+  double average = (done_nodes + current_total) / (progress[0].done + 1); // sampled average task size
+  int remaining = progress[0].total - progress[0].done - 1;
+  double total = done_nodes + current_total + (remaining > 0 ? remaining * average : 0);
+  fraction = total > 0 ? (done_nodes + current_nodes) / total : 0;
+  if(fraction < progressDone) fraction = progressDone; // estimations are revised, but reported progress never goes back
+  progressDone = fraction;
+
+  Progress p;
+  p.done = fraction;
+  p.nodes = nodeCount;
+  p.elapsed = std::chrono::duration<double>(now - progressStart).count();
+  p.eta = fraction > 0 ? p.elapsed * (1 - fraction) / fraction : 0;
+  progressCallback(p);
+}
+
 // Constructor
-Solver::Solver() : nodeCount{0} {
+Solver::Solver() : nodeCount{0}, nodeLimit{std::numeric_limits<unsigned long long>::max()}, aborted{false}, progressDepth{0}, progressDone{0}, progressRoot{-1}, progressInterval{1.0},
+  checkpointInterval{600}, checkpointResume{false}, checkpointRoot{-1}, checkpointMin{0}, checkpointMax{0},
+  diskTable{nullptr}, diskDepth{-1}, diskMinNodes{0}, learnedDepth{-1}, learnedMinNodes{0}, tracer{nullptr}, costOrderingDepth{0}, remoteDepth{-1}, extras{false} {
   for(int i = 0; i < Position::WIDTH; i++) // initialize the column exploration order, starting with center columns
     columnOrder[i] = Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2; // example for WIDTH=7: columnOrder = {3, 4, 2, 5, 1, 6, 0}
 }
 
+// Destructor
+Solver::~Solver() {
+  waitBook();
+  delete diskTable;
+}
+
 } // namespace Connect4
 } // namespace GameSolver
@@ -20,21 +20,115 @@
 #define SOLVER_HPP
 
 #include <vector>
+#include <map>
 #include <string>
+#include <chrono>
+#include <functional>
+#include <thread>
 #include "Position.hpp"
 #include "TranspositionTable.hpp"
 #include "OpeningBook.hpp"
+#include "LearnedBook.hpp"
+#include "MoveOrdering.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
 
 namespace GameSolver {
 namespace Connect4 {
 
+class MoveSorter;
+template<class key_t, class value_t> class DiskTranspositionTable;
+
 class Solver {
+ public:
+  /**
+   * Progress of a running search, as given to the progress callback.
+   */
+  struct Progress {
+    double done;              // estimated fraction of the search already done, between 0 and 1, never decreases
+    unsigned long long nodes; // number of explored nodes so far
+    double elapsed;           // time spent since the beginning of the search in seconds
+    double eta;               // estimated remaining time in seconds
+  };
+
  private:
   static constexpr int TABLE_SIZE = 24; // store 2^TABLE_SIZE elements in the transpositiontbale
   TranspositionTable < uint_t < Position::WIDTH*(Position::HEIGHT + 1) - TABLE_SIZE >, Position::position_t, uint8_t, TABLE_SIZE > transTable;
   OpeningBook book{Position::WIDTH, Position::HEIGHT}; // opening book
+  std::thread bookLoader; // background loading of the opening book
   unsigned long long nodeCount; // counter of explored nodes.
+  unsigned long long nodeLimit; // search is stopped when nodeCount exceeds this limit
+  bool aborted;                 // true when the search was stopped by nodeLimit
   int columnOrder[Position::WIDTH]; // column exploration order
+  MoveOrdering ordering; // scoring of the moves to sort them before exploration
+  Profiler profiler;     // time spent in each phase of negamax, only measured if compiled with SOLVER_PROFILE
+
+  /**
+   * Progress estimation.
+   * The first levels of the search tree are tracked by a stack of frames, frame 0 being the
+   * tasks of the root driver (narrowing iterations of solve, or moves of analyze/bestMove)
+   * and frame d the moves of the position at d-1 plies below the driver.
+   * Tasks of the driver are weighted by their number of nodes: the remaining tasks are expected
+   * to have the average size of the explored ones. Sizes of sibling subtrees of the search tree
+   * differ by orders of magnitude and make poor estimators: they are given the same weight instead.
+   */
+  static constexpr int PROGRESS_DEPTH = 8; // number of tracked frames
+  struct {
+    int done;  // number of fully explored subtrees
+    int total; // total number of subtrees
+    unsigned long long start;      // node count when the frame started
+    unsigned long long childStart; // node count when the current subtree started
+  } progress[PROGRESS_DEPTH];
+  int progressDepth; // number of active frames
+  double progressDone; // last reported fraction done
+  int progressRoot;  // number of moves of the positions at frame 1, -1 if no progress is tracked
+  std::function<void(const Progress &)> progressCallback;
+  double progressInterval; // minimum time between two calls to the callback in seconds
+  std::chrono::steady_clock::time_point progressStart, progressLast;
+
+  /**
+   * Checkpoints.
+   * While narrowing a position, its state is periodically saved to a file: the proven interval
+   * of the score, the node count, the transposition table and the results of the root moves
+   * already explored in the current iteration (as they are likely to be evicted from the
+   * transposition table by the time the checkpoint is restored).
+   */
+  std::string checkpointFile; // empty if checkpoints are disabled
+  double checkpointInterval;  // minimum time between two checkpoints in seconds
+  bool checkpointResume;      // restore the checkpoint when narrowing the position it was saved for
+  int checkpointRoot;         // number of moves of the position being narrowed, -1 if none
+  Position checkpointPosition;
+  int *checkpointMin, *checkpointMax; // proven interval of the score of the position being narrowed
+  std::vector<std::pair<Position::position_t, uint8_t>> checkpointEntries; // root moves keys and values
+  std::chrono::steady_clock::time_point checkpointLast;
+
+  DiskTranspositionTable<Position::position_t, uint8_t> *diskTable; // optional second tier transposition table, nullptr until enabled
+  int diskDepth; // disk table is used for positions with at most diskDepth moves, -1 if disabled
+  unsigned long long diskMinNodes; // minimum subtree size to store a position in the disk table
+
+  LearnedBook<Position::position_t> learnedBook{Position::WIDTH, Position::HEIGHT}; // bounds of expensive positions
+  std::string learnedFile; // file of the learned book
+  int learnedDepth;        // learned book is used for positions with at most learnedDepth moves, -1 if disabled
+  unsigned long long learnedMinNodes; // minimum subtree size to record a position in the learned book
+
+  Tracer *tracer; // optional timeline tracer, shared with other solvers
+
+  int costOrderingDepth; // subtree sizes are used for move ordering below this number of moves
+
+  std::function<bool(const Position &, int, int, int &)> remoteSearch; // optional search of positions by other processes
+  int remoteDepth; // positions with up to this number of moves are given to remoteSearch
+
+  bool extras; // true if any optional feature of the search is enabled, otherwise the plain search is used
+  void updateExtras();
+
+  static constexpr unsigned long long PERIODIC_NODES = (1 << 20) - 1; // progress and checkpoints are checked every 2^20 nodes
+
+  void periodicTasks();
+  bool startProgress(int root);
+  void setProgress(int frame, int done, int total);
+  void reportProgress();
+  void saveCheckpoint();
+  bool loadCheckpoint(const Position &P, int &lowest, int &highest);
 
   /**
    * Reccursively score connect 4 position using negamax variant of alpha-beta algorithm.
@@ -46,8 +140,44 @@ class Solver {
    * - if actual score of position <= alpha then actual score <= return value <= alpha
    * - if actual score of position >= beta then beta <= return value <= actual score
    * - if alpha <= actual score <= beta then return value = actual score
+   * @param with_extras: false for the plain search, ignoring all the optional features (see extras).
+   */
+  template<bool with_extras> int negamax(const Position &P, int alpha, int beta);
+
+  // negamax with the optional features only if some are enabled
+  int negamax(const Position &P, int alpha, int beta) {
+    return extras ? negamax<true>(P, alpha, beta) : negamax<false>(P, alpha, beta);
+  }
+
+  void narrow(const Position &P, int &min, int &max);
+
+  // Returns the score of a position stored in the opening book, or INVALID_MOVE if it is not covered by the book.
+  int bookScore(const Position &P) const {
+    int val = book.get(P);
+    return val ? val + Position::MIN_SCORE - 1 : INVALID_MOVE;
+  }
+
+  static constexpr int DEAD_POSITION_MOVES = 3 * Position::WIDTH * Position::HEIGHT / 4; // dead positions are only looked for from this number of moves, they are too rare before
+  static constexpr int SYMMETRY_MOVES = 16; // symmetric positions are only looked for below this number of moves, they are too rare after
+  static constexpr int BOOK_GUESS_PLIES = 4; // how far beyond the opening book depth ancestors are looked up
+
+  /**
+   * Collect the opening book scores of the ancestors of a position.
+   * Ancestors are obtained by removing top stones of alternating colors.
+   * @param plies: number of stones to remove.
+   * @param sign: 1 if the position player is the ancestor player, -1 otherwise.
+   * @param scores: book scores found by key3 of the ancestors, from the point of view of the position player.
+   *        An ancestor reached by several orders of removal is only counted once.
    */
-  int negamax(const Position &P, int alpha, int beta);
+  void bookAncestors(Position P, int plies, int sign, std::map<Position::position_t, int> &scores) const;
+
+  template<bool with_extras = true> void store(const Position &P, Position::position_t key, uint8_t value, unsigned long long nodes);
+
+  // Add the moves to explore in a position to the sorter, in exploration order. @return number of moves
+  template<bool with_extras = true> int sortMoves(const Position &P, Position::position_t possible, MoveSorter &moves) const;
+
+  struct BatchSearch;
+  bool step(BatchSearch &s);
 
  public:
   static const int INVALID_MOVE = -1000;
@@ -55,24 +185,196 @@ class Solver {
   // Returns the score of a position
   int solve(const Position &P, bool weak = false);
 
+  // Solves a position exploring at most max_nodes nodes.
+  // Sets [min;max] to the interval proven to contain the score of the position
+  // and returns true if the exact score was found (min == max).
+  bool solve(const Position &P, bool weak, unsigned long long max_nodes, int &min, int &max);
+
+  // Returns the score of a position using a caller supplied interval [min;max] known to contain
+  // the score (for example from the analysis of a parent position) to save narrowing iterations.
+  // If the actual score is outside [min;max], the closest bound is returned.
+  int solveWithHint(const Position &P, int min, int max);
+
+  // Returns true if the score of a position is at least threshold, using a single null window search.
+  bool scoreAtLeast(const Position &P, int threshold);
+
+  /**
+   * Callback of a streaming analysis, called as soon as the score of a column is proven.
+   * @param column: 0-based index of the column.
+   * @param score: score of the column.
+   * @param best: 0-based index of the best column among the ones already proven.
+   */
+  typedef std::function<void(int column, int score, int best)> AnalyzeCallback;
+
   // Returns the score off all possible moves of a position as an array.
   // Returns INVALID_MOVE for unplayable columns
-  std::vector<int> analyze(const Position &P, bool weak = false);
+  // The optional callback receives each score as soon as it is proven: immediate wins and positions
+  // inside the opening book first, then the searched columns in exploration order.
+  std::vector<int> analyze(const Position &P, bool weak = false, AnalyzeCallback callback = nullptr);
+
+  // Returns the 0-based index of a column with an optimal score, only solving exactly
+  // the most promising move and checking the other moves with null window searches.
+  // Returns INVALID_MOVE if there is no playable column.
+  int bestMove(const Position &P, bool weak = false);
+
+  /**
+   * Solve independent positions, interleaving several searches on the current thread to hide
+   * the latency of the transposition table: each search prefetches the table entry of its
+   * next position and lets the other searches run until the entry is likely in cache.
+   * Progress, checkpoints, tracing, the disk transposition table and the learned book are not supported.
+   * @param lanes: number of interleaved searches.
+   * @return the score of each position, as given by solve.
+   */
+  std::vector<int> solveBatch(const std::vector<Position> &positions, bool weak = false, int lanes = 8);
+
+  // Returns a cheap estimation of the cost of solving a position, as the log2 of the number of explored nodes.
+  // Positions in the opening book or with an immediate win are free, otherwise the cost grows with the
+  // number of empty cells and decreases with the number of threats of both players.
+  double estimateDifficulty(const Position &P) const;
 
   unsigned long long getNodeCount() const {
     return nodeCount;
   }
 
+  const Profiler &getProfiler() const {
+    return profiler;
+  }
+
   void reset() {
     nodeCount = 0;
+    profiler.reset();
     transTable.reset();
   }
 
-  void loadBook(std::string book_file) {
-    book.load(book_file);
+  /**
+   * Record the log2 of the subtree size of the transposition table entries:
+   * expensive entries are kept on collisions, with aging to eventually replace old ones.
+   * @param ordering_depth: on equal move ordering scores, positions with less moves explore
+   *        first the children with larger known subtrees (0 to disable).
+   */
+  void enableCosts(int ordering_depth = 0) {
+    transTable.enableCosts();
+    costOrderingDepth = ordering_depth;
+    updateExtras();
+  }
+
+  const MoveOrdering &getMoveOrdering() const {
+    return ordering;
+  }
+
+  void setMoveOrdering(const MoveOrdering &o) {
+    ordering = o;
+    updateExtras();
+  }
+
+  /**
+   * Set a callback periodically receiving the estimated progress of long searches.
+   * @param callback: function to call, or nullptr to disable progress estimation.
+   * @param interval: minimum time between two calls in seconds.
+   */
+  void setProgressCallback(std::function<void(const Progress &)> callback, double interval = 1.0) {
+    progressCallback = callback;
+    progressInterval = interval;
+  }
+
+  /**
+   * Periodically save the state of solve to a file, to be able to resume it after an interruption.
+   * @param file: checkpoint file, empty string to disable checkpoints.
+   * @param interval: minimum time between two checkpoints in seconds.
+   * @param resume: restore the state saved in the file when solving the position it was saved for.
+   */
+  void setCheckpoint(const std::string &file, double interval = 600, bool resume = false) {
+    checkpointFile = file;
+    checkpointInterval = interval;
+    checkpointResume = resume;
+  }
+
+  /**
+   * Enable a second tier transposition table stored in a memory mapped file, for very long solves.
+   * Its content is kept by reset() and between runs.
+   * @param file: file storing the table, ideally on a fast local drive.
+   * @param log_size: the table contains 2^log_size + 1 entries.
+   * @param max_depth: the table is only used for positions with at most max_depth moves.
+   * @param min_nodes: only results of subtrees of at least min_nodes nodes are stored.
+   * @return true in case of success, false if the file cannot be created or is not a table of this
+   *         size for this board (an existing file is never overwritten), the table is then disabled.
+   */
+  bool enableDiskTable(const std::string &file, int log_size = 28, int max_depth = 16, unsigned long long min_nodes = 1 << 12);
+
+  /**
+   * Enable a learned book: bounds of the expensive positions searched are recorded and probed
+   * by later searches, to avoid solving again the same costly subtrees beyond the opening book.
+   * @param file: file of the learned book, loaded if it exists and written by saveLearnedBook.
+   * @param max_depth: the book is only used for positions with at most max_depth moves.
+   * @param min_nodes: only positions whose subtree has at least min_nodes nodes are recorded.
+   * @return false if the file exists but cannot be loaded.
+   */
+  bool enableLearnedBook(const std::string &file, int max_depth = 24, unsigned long long min_nodes = 1 << 16) {
+    learnedFile = file;
+    learnedDepth = max_depth;
+    learnedMinNodes = min_nodes;
+    updateExtras();
+    return learnedBook.load(file);
+  }
+
+  // Save the learned book to its file, @return true in case of success
+  bool saveLearnedBook() const {
+    if(learnedDepth < 0) return false;
+    std::cerr << "Learned book: " << learnedBook.size() << " positions, " << learnedBook.nbExact() << " exact scores" << std::endl;
+    return learnedBook.save(learnedFile);
+  }
+
+  /**
+   * Score a position within a [alpha;beta] window, with the same guarantees than negamax
+   * on the returned value. The position can have a winning move.
+   */
+  int searchWindow(const Position &P, int alpha, int beta);
+
+  /**
+   * Delegate the search of some positions, typically to the process owning them in a distributed search.
+   * @param search: called with a position and a window, returns false if the position has to be searched
+   *        locally, otherwise true and a score with the guarantees of searchWindow.
+   * @param max_depth: only positions with up to this number of moves are given to search.
+   */
+  void setRemoteSearch(std::function<bool(const Position &, int, int, int &)> search, int max_depth) {
+    remoteSearch = search;
+    remoteDepth = max_depth;
+    updateExtras();
+  }
+
+  /**
+   * Set a tracer recording the timeline of the searches (narrowing iterations, root moves, checkpoints).
+   * @param t: tracer, possibly shared by several solvers, or nullptr to disable tracing.
+   */
+  void setTracer(Tracer *t) {
+    tracer = t;
+  }
+
+  /**
+   * Load an opening book file.
+   * @param background: load the book in a background thread and return at once. Until the load
+   *        is complete, positions are solved as if there was no opening book.
+   */
+  void loadBook(std::string book_file, bool background = false) {
+    if(bookLoader.joinable()) bookLoader.join(); // a book cannot be replaced while it is loaded
+    if(background) bookLoader = std::thread([this, book_file] {book.load(book_file);});
+    else book.load(book_file);
+  }
+
+  // Wait for the end of the background loading of the opening book, if any
+  void waitBook() {
+    if(bookLoader.joinable()) bookLoader.join();
+  }
+
+  // Use an opening book already in memory (see OpeningBook::load), without copy if suitably aligned
+  void loadBook(const char *data, size_t length) {
+    waitBook();
+    book.load(data, length);
   }
 
   Solver(); // Constructor
+
+  ~Solver(); // Destructor
 };
 
 } // namespace Connect4
@@ -0,0 +1,142 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Timeline tracer writing spans in the Chrome trace event JSON format,
+ * to be inspected in a timeline viewer (chrome://tracing, Perfetto).
+ *
+ * Spans are written as complete events ("ph":"X") when they end, with the
+ * id of the thread that recorded them, so that a single tracer can be shared
+ * by several threads and solvers.
+ */
+class Tracer {
+ public:
+  /**
+   * A span of the timeline, recorded from its construction to its destruction.
+   * A span built with a null tracer does nothing, without any allocation or formatting.
+   * @param category, name: static strings, they are not copied.
+   */
+  class Span {
+   public:
+    Span(Tracer *tracer, const char *category, const char *name) : tracer{tracer}, category{category}, name{name}, start{0} {
+      if(tracer) start = tracer->now();
+    }
+
+    /**
+     * Add an argument displayed with the span
+     */
+    void arg(const char *key, long long value) {
+      if(!tracer) return;
+      if(!args.empty()) args += ",";
+      args += std::string("\"") + key + "\":" + std::to_string(value);
+    }
+
+    ~Span() {
+      if(tracer) tracer->write(category, name, start, tracer->now() - start, args);
+    }
+
+   private:
+    Tracer *tracer;
+    const char *category;
+    const char *name;
+    double start; // in microseconds
+    std::string args; // only filled with a tracer
+  };
+
+  /**
+   * Open the trace file
+   * @return true in case of success.
+   */
+  bool open(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ofs.open(filename);
+    if(ofs.fail()) {
+      std::cerr << "Unable to open trace file: " << filename << std::endl;
+      return false;
+    }
+    ofs << "{\"traceEvents\":[" << std::endl;
+    first = true;
+    return true;
+  }
+
+  /**
+   * @return time since the creation of the tracer in microseconds
+   */
+  double now() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+  }
+
+  /**
+   * Write a complete event.
+   * @param args: arguments as the content of a JSON object, possibly empty.
+   */
+  void write(const char *category, const char *name, double start, double duration, const std::string &args) {
+    int tid = threadId();
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!ofs.is_open()) return;
+    ofs << (first ? "" : ",\n") << "{\"name\":\"" << name << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"ts\":" << std::fixed
+        << start << ",\"dur\":" << duration << ",\"pid\":1,\"tid\":" << tid << ",\"args\":{" << args << "}}";
+    first = false;
+  }
+
+  /**
+   * Terminate and close the trace file.
+   */
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!ofs.is_open()) return;
+    ofs << "\n]}" << std::endl;
+    ofs.close();
+  }
+
+  Tracer() : origin{std::chrono::steady_clock::now()}, first{true} {}
+
+  ~Tracer() {
+    close();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point origin;
+  std::ofstream ofs;
+  std::mutex mutex;
+  bool first; // no event written yet
+
+  // small sequential id of the calling thread
+  static int threadId() {
+    static std::atomic<int> next{0};
+    thread_local int id = next++;
+    return id;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -20,6 +20,7 @@
 #define TRANSPOSITION_TABLE_HPP
 
 #include <cstring>
+#include <iostream>
 
 namespace GameSolver {
 namespace Connect4 {
@@ -96,6 +97,8 @@ class TranspositionTable : public TableGetter<key_t, value_t> {
   static const size_t size = next_prime(1 << log_size); // size of the transition table. Have to be odd to be prime with 2^sizeof(key_t)
   partial_key_t *K;     // Array to store truncated version of keys;
   value_t *V;   // Array to store values;
+  uint8_t *C;   // Optional array to store the log2 of the cost of computing the values
+  bool owner;   // false when K and V point to external read-only memory
 
   void* getKeys()    override {return K;}
   void* getValues()  override {return V;}
@@ -108,15 +111,28 @@ class TranspositionTable : public TableGetter<key_t, value_t> {
   }
 
  public:
-  TranspositionTable() {
+  TranspositionTable() : C{0}, owner{true} {
     K = new partial_key_t[size];
     V = new value_t[size];
     reset();
   }
 
+  /**
+   * Read-only table using external memory without copy, laid out as written by save:
+   * size keys followed by size values. The memory must outlive the table,
+   * be aligned for partial_key_t and must not be modified (no put, reset or load).
+   */
+  explicit TranspositionTable(const char *data) : C{0}, owner{false} {
+    K = reinterpret_cast<partial_key_t *>(const_cast<char *>(data));
+    V = reinterpret_cast<value_t *>(const_cast<char *>(data) + size * sizeof(partial_key_t));
+  }
+
   ~TranspositionTable() {
-    delete[] K;
-    delete[] V;
+    if(owner) {
+      delete[] K;
+      delete[] V;
+    }
+    delete[] C;
   }
 
   /**
@@ -125,6 +141,43 @@ class TranspositionTable : public TableGetter<key_t, value_t> {
   void reset() { // fill everything with 0, because 0 value means missing data
     memset(K, 0, size * sizeof(partial_key_t));
     memset(V, 0, size * sizeof(value_t));
+    if(C) memset(C, 0, size);
+  }
+
+  /**
+   * Record the cost of the stored values, and use it to keep expensive entries.
+   * Costs are not part of the saved content of the table.
+   */
+  void enableCosts() {
+    if(!C) {
+      C = new uint8_t[size];
+      memset(C, 0, size);
+    }
+  }
+
+  bool hasCosts() const {
+    return C;
+  }
+
+  /**
+   * Write the whole content of the table to a binary stream.
+   * @return true in case of success.
+   */
+  bool save(std::ostream &os) const {
+    os.write(reinterpret_cast<const char *>(K), size * sizeof(partial_key_t));
+    os.write(reinterpret_cast<const char *>(V), size * sizeof(value_t));
+    return !os.fail();
+  }
+
+  /**
+   * Read the whole content of the table from a binary stream written by save.
+   * @return true in case of success, the table content is undefined otherwise.
+   */
+  bool load(std::istream &is) {
+    is.read(reinterpret_cast<char *>(K), size * sizeof(partial_key_t));
+    is.read(reinterpret_cast<char *>(V), size * sizeof(value_t));
+    if(C) memset(C, 0, size);
+    return !is.fail();
   }
 
   /**
@@ -136,6 +189,16 @@ class TranspositionTable : public TableGetter<key_t, value_t> {
     size_t pos = index(key);
     K[pos] = key; // key is possibly trucated as key_t is possibly less than key_size bits.
     V[pos] = value;
+    if(C) C[pos] = 0;
+  }
+
+  /**
+   * Start loading the entry of a key in cache, to be read later by get.
+   */
+  void prefetch(key_t key) const {
+    size_t pos = index(key);
+    __builtin_prefetch(K + pos);
+    __builtin_prefetch(V + pos);
   }
 
   /**
@@ -148,6 +211,33 @@ class TranspositionTable : public TableGetter<key_t, value_t> {
     if(K[pos] == (partial_key_t)key) return V[pos]; // need to cast to key_t because key may be truncated due to size of key_t
     else return 0;
   }
+
+  /**
+   * Store a value for a given key with the cost of computing it, when costs are enabled.
+   * A more expensive entry of another key is kept, but its cost is decreased so that
+   * old expensive entries are eventually replaced.
+   * @param cost: log2 of the cost of computing the value, at least 1.
+   */
+  void put(key_t key, value_t value, uint8_t cost) {
+    size_t pos = index(key);
+    if(C[pos] > cost && K[pos] != (partial_key_t)key) {
+      C[pos]--; // aging
+      return;
+    }
+    K[pos] = key;
+    V[pos] = value;
+    C[pos] = cost;
+  }
+
+  /**
+   * Get the cost of the value of a key, when costs are enabled.
+   * @return the cost stored with the value if present, 0 otherwise.
+   */
+  uint8_t getCost(key_t key) const {
+    size_t pos = index(key);
+    if(K[pos] == (partial_key_t)key) return C[pos];
+    else return 0;
+  }
 };
 
 } // namespace Connect4
@@ -0,0 +1,118 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Solver.hpp"
+#include "PerfCounters.hpp"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+using namespace GameSolver::Connect4;
+
+/**
+ * Benchmark tool.
+ * Reads Connect 4 positions, line by line, from standard input, solves each of them
+ * from an empty transposition table and writes one line per position to standard output containing:
+ *  - the position and its score
+ *  - number of nodes explored
+ *  - time spent in microseconds
+ *  - hardware counters (cycles, instructions, IPC, L1d/LLC/dTLB read misses, branch misses)
+ *    or "n/a" if a counter is not available
+ *
+ * A summary is written at the end with the totals and, if the solver is compiled with
+ * SOLVER_PROFILE (make bench), the breakdown of the time spent in each phase of negamax.
+ * The remaining time is spent in recursion and search logic.
+ *
+ * Parameters: -w for weak solver, -b <file> to use an opening book.
+ */
+int main(int argc, char** argv) {
+  Solver solver;
+  PerfCounters counters;
+  bool weak = false;
+  std::string opening_book;
+  for(int i = 1; i < argc; i++) {
+    if(argv[i][0] == '-') {
+      if(argv[i][1] == 'w') weak = true; // parameter -w: use weak solver
+      else if(argv[i][1] == 'b') { // paramater -b: use an opening book
+        if(++i < argc) opening_book = std::string(argv[i]);
+      }
+    }
+  }
+  if(!opening_book.empty()) solver.loadBook(opening_book);
+
+  unsigned long long total_nodes = 0;
+  double total_time = 0;
+  uint64_t total_ticks = 0;
+  uint64_t total_counters[PerfCounters::NB_COUNTERS] = {0};
+  uint64_t phase_ticks[Profiler::NB_PHASES] = {0};
+
+  std::string line;
+  for(int l = 1; std::getline(std::cin, line); l++) {
+    Position P;
+    if(P.play(line) != line.size()) {
+      std::cerr << "Line " << l << ": Invalid move " << (P.nbMoves() + 1) << " \"" << line << "\"" << std::endl;
+      continue;
+    }
+    solver.reset();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t start_ticks = Profiler::ticks();
+    counters.start();
+    int score = solver.solve(P, weak);
+    counters.stop();
+    total_ticks += Profiler::ticks() - start_ticks;
+    double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    total_nodes += solver.getNodeCount();
+    total_time += time;
+    for(int i = 0; i < Profiler::NB_PHASES; i++) phase_ticks[i] += solver.getProfiler().time[i];
+
+    std::cout << line << " " << score << " " << solver.getNodeCount() << " " << std::fixed << std::setprecision(0) << time;
+    for(int i = 0; i < PerfCounters::NB_COUNTERS; i++) {
+      total_counters[i] += counters.get(i);
+      if(counters.available(i)) std::cout << " " << counters.get(i);
+      else std::cout << " n/a";
+      if(i == PerfCounters::INSTRUCTIONS) { // instructions per cycle
+        if(counters.available(PerfCounters::CYCLES) && counters.available(PerfCounters::INSTRUCTIONS) && counters.get(PerfCounters::CYCLES))
+          std::cout << " " << std::setprecision(2) << double(counters.get(PerfCounters::INSTRUCTIONS)) / counters.get(PerfCounters::CYCLES);
+        else std::cout << " n/a";
+      }
+    }
+    std::cout << std::endl;
+  }
+
+  std::cout << "total nodes: " << total_nodes << " time: " << std::setprecision(0) << total_time << "us";
+  if(total_time > 0) std::cout << " (" << total_nodes / total_time * 1000 << " knodes/s)";
+  std::cout << std::endl;
+  for(int i = 0; i < PerfCounters::NB_COUNTERS; i++)
+    if(counters.available(i)) {
+      std::cout << PerfCounters::name(i) << ": " << total_counters[i];
+      if(total_nodes) std::cout << " (" << std::setprecision(2) << double(total_counters[i]) / total_nodes << " per node)";
+      std::cout << std::endl;
+    }
+    else std::cout << PerfCounters::name(i) << ": n/a" << std::endl;
+  if(total_counters[PerfCounters::CYCLES])
+    std::cout << "IPC: " << std::setprecision(2) << double(total_counters[PerfCounters::INSTRUCTIONS]) / total_counters[PerfCounters::CYCLES] << std::endl;
+
+  uint64_t profiled = 0;
+  for(int i = 0; i < Profiler::NB_PHASES; i++) profiled += phase_ticks[i];
+  if(profiled && total_ticks) {
+    for(int i = 0; i < Profiler::NB_PHASES; i++)
+      std::cout << Profiler::name(i) << ": " << std::setprecision(1) << 100.0 * phase_ticks[i] / total_ticks << "%" << std::endl;
+    std::cout << "recursion: " << 100.0 * (total_ticks - profiled) / total_ticks << "%" << std::endl;
+  }
+}
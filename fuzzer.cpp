@@ -0,0 +1,543 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Solver.hpp"
+#include "MoveSorter.hpp"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <ctime>
+#include <cstdlib>
+
+using namespace GameSolver::Connect4;
+
+/**
+ * Slow and obviously correct reference board: a grid of cells (0: empty, 1: first player, 2: second player)
+ */
+struct Board {
+  static constexpr int WIDTH = Position::WIDTH;
+  static constexpr int HEIGHT = Position::HEIGHT;
+  int cell[WIDTH][HEIGHT] = {};
+  int height[WIDTH] = {};
+  int moves = 0;
+
+  int current() const {return 1 + moves % 2;} // player to play
+  int opponent() const {return 2 - moves % 2;}
+  bool canPlay(int col) const {return height[col] < HEIGHT;}
+
+  void play(int col) {
+    cell[col][height[col]++] = current();
+    moves++;
+  }
+
+  void undo(int col) {
+    cell[col][--height[col]] = 0;
+    moves--;
+  }
+
+  bool inside(int col, int row) const {return col >= 0 && col < WIDTH && row >= 0 && row < HEIGHT;}
+
+  // whether a stone of player at (col, row) makes an alignment, whatever the cell contains
+  bool aligns(int col, int row, int player) const {
+    static const int dirs[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
+    for(const int *d : dirs) {
+      int n = 1;
+      for(int s = -1; s <= 1; s += 2)
+        for(int c = col + s * d[0], r = row + s * d[1]; inside(c, r) && cell[c][r] == player; c += s * d[0], r += s * d[1]) n++;
+      if(n >= 4) return true;
+    }
+    return false;
+  }
+
+  bool isWinningMove(int col) const {return canPlay(col) && aligns(col, height[col], current());}
+
+  bool canWinNext() const {
+    for(int col = 0; col < WIDTH; col++) if(isWinningMove(col)) return true;
+    return false;
+  }
+
+  // number of empty cells completing an alignment of any player
+  int nbThreats() const {
+    int n = 0;
+    for(int col = 0; col < WIDTH; col++)
+      for(int row = 0; row < HEIGHT; row++)
+        if(!cell[col][row] && (aligns(col, row, 1) || aligns(col, row, 2))) n++;
+    return n;
+  }
+
+  // number of empty cells completing an alignment of the current player after playing a column
+  int moveScore(int col) {
+    play(col);
+    int n = 0;
+    for(int c = 0; c < WIDTH; c++)
+      for(int r = 0; r < HEIGHT; r++)
+        if(!cell[c][r] && aligns(c, r, opponent())) n++;
+    undo(col);
+    return n;
+  }
+
+  // whether player has a line of 4 cells without opponent stone
+  bool canStillAlign(int player) const {
+    static const int dirs[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
+    for(int col = 0; col < WIDTH; col++)
+      for(int row = 0; row < HEIGHT; row++)
+        for(const int *d : dirs) {
+          bool free = inside(col + 3 * d[0], row + 3 * d[1]);
+          for(int i = 0; free && i < 4; i++) free = cell[col + i * d[0]][row + i * d[1]] != 3 - player;
+          if(free) return true;
+        }
+    return false;
+  }
+
+  // columns that do not let the opponent win next move
+  std::vector<int> nonLosingMoves() {
+    std::vector<int> cols;
+    for(int col = 0; col < WIDTH; col++)
+      if(canPlay(col)) {
+        play(col);
+        if(!canWinNext()) cols.push_back(col);
+        undo(col);
+      }
+    return cols;
+  }
+
+  Position::position_t key() const {
+    Position::position_t k = 0;
+    for(int col = 0; col < WIDTH; col++) {
+      for(int row = 0; row < height[col]; row++)
+        if(cell[col][row] == current()) k += Position::position_t(1) << (col * (HEIGHT + 1) + row);
+      k += Position::position_t(1) << (col * (HEIGHT + 1) + height[col]); // current + mask adds a bit above each column
+      k -= Position::position_t(1) << (col * (HEIGHT + 1));
+    }
+    return k;
+  }
+
+  bool isSymmetric() const {
+    for(int col = 0; col < WIDTH / 2; col++)
+      for(int row = 0; row < HEIGHT; row++)
+        if(cell[col][row] != cell[WIDTH - 1 - col][row]) return false;
+    return true;
+  }
+
+  // plain negamax without any pruning, only used near the end of the game
+  int solve() {
+    if(moves == WIDTH * HEIGHT) return 0;
+    for(int col = 0; col < WIDTH; col++)
+      if(isWinningMove(col)) return (WIDTH * HEIGHT + 1 - moves) / 2;
+    int best = -WIDTH * HEIGHT;
+    for(int col = 0; col < WIDTH; col++)
+      if(canPlay(col)) {
+        play(col);
+        best = std::max(best, -solve());
+        undo(col);
+      }
+    return best;
+  }
+};
+
+std::mt19937_64 rng;
+unsigned long long iteration;
+int failures = 0;
+
+void fail(const std::string &check, const std::string &moves, const std::string &detail) {
+  std::cerr << "FAIL " << check << " at iteration " << iteration << " position \"" << moves << "\": " << detail << std::endl;
+  failures++;
+}
+
+template<class T> std::string str(const T &a, const T &b) {
+  std::ostringstream oss;
+  oss << "got " << a << " expected " << b;
+  return oss.str();
+}
+
+/**
+ * Play a random game of random length, stopping before any alignment.
+ */
+std::string randomGame(Board &B, Position &P, int length) {
+  std::string moves;
+  while(B.moves < length) {
+    std::vector<int> cols;
+    for(int col = 0; col < Board::WIDTH; col++)
+      if(B.canPlay(col) && !B.isWinningMove(col)) cols.push_back(col);
+    if(cols.empty()) break;
+    int col = cols[rng() % cols.size()];
+    B.play(col);
+    P.playCol(col);
+    moves += char('1' + col);
+  }
+  return moves;
+}
+
+/**
+ * Bitboard primitives against the reference board, for every prefix of a random game
+ */
+void checkPosition(const std::string &moves, Board &B, const Position &P) {
+  if(P.nbMoves() != B.moves) fail("nbMoves", moves, str(P.nbMoves(), B.moves));
+  if(P.key() != B.key()) fail("key", moves, "incremental and reference keys differ");
+  if(P.isSymmetric() != B.isSymmetric()) fail("isSymmetric", moves, str(P.isSymmetric(), B.isSymmetric()));
+  if(P.canWinNext() != B.canWinNext()) fail("canWinNext", moves, str(P.canWinNext(), B.canWinNext()));
+  if(P.nbThreats() != B.nbThreats()) fail("nbThreats", moves, str(P.nbThreats(), B.nbThreats()));
+  if(P.canStillAlign() != B.canStillAlign(B.current())) fail("canStillAlign", moves, str(P.canStillAlign(), B.canStillAlign(B.current())));
+  if(P.opponentCanStillAlign() != B.canStillAlign(B.opponent()))
+    fail("opponentCanStillAlign", moves, str(P.opponentCanStillAlign(), B.canStillAlign(B.opponent())));
+
+  Position mirror; // key3 is shared by mirror positions
+  for(char c : moves) mirror.playCol(Board::WIDTH - 1 - (c - '1'));
+  if(P.key3() != mirror.key3()) fail("key3", moves, "mirror positions have different keys");
+
+  for(int col = 0; col < Board::WIDTH; col++) {
+    if(P.canPlay(col) != B.canPlay(col)) fail("canPlay", moves, str(P.canPlay(col), B.canPlay(col)));
+    if(B.canPlay(col) && P.isWinningMove(col) != B.isWinningMove(col))
+      fail("isWinningMove", moves, str(P.isWinningMove(col), B.isWinningMove(col)));
+    bool undo = B.height[col] && B.cell[col][B.height[col] - 1] == B.opponent();
+    if(P.canUndo(col) != undo) fail("canUndo", moves, str(P.canUndo(col), undo));
+    if(undo) {
+      Position P2(P);
+      P2.undoCol(col);
+      B.undo(col);
+      if(P2.key() != B.key() || P2.nbMoves() != B.moves) fail("undoCol", moves, "parent position differs");
+      B.play(col); // put the stone back
+    }
+  }
+
+  if(!B.canWinNext()) {
+    std::vector<int> cols = B.nonLosingMoves();
+    Position::position_t expected = 0;
+    for(int col : cols) expected |= Position::column_mask(col);
+    Position::position_t possible = P.possibleNonLosingMoves();
+    for(int col = 0; col < Board::WIDTH; col++) {
+      if(bool(possible & Position::column_mask(col)) != bool(expected & Position::column_mask(col)))
+        fail("possibleNonLosingMoves", moves, "column " + std::to_string(col + 1));
+      if(Position::position_t move = possible & Position::column_mask(col))
+        if(P.moveScore(move) != B.moveScore(col)) fail("moveScore", moves, str(P.moveScore(move), B.moveScore(col)));
+    }
+  }
+}
+
+/**
+ * MoveSorter against a stable sort: decreasing scores, last added first among equal scores
+ */
+void checkSorter() {
+  MoveSorter sorter;
+  std::vector<std::pair<int, Position::position_t>> entries;
+  int n = rng() % (Position::WIDTH + 1);
+  int range = 1 + rng() % 8; // small ranges give many ties
+  for(int i = 0; i < n; i++) {
+    int score = int(rng() % (2 * range + 1)) - range;
+    if(rng() % 8 == 0) score *= 1000000;
+    Position::position_t move = Position::position_t(1) << i;
+    sorter.add(move, score);
+    entries.push_back(std::make_pair(score, move));
+  }
+  std::reverse(entries.begin(), entries.end());
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const std::pair<int, Position::position_t> &a, const std::pair<int, Position::position_t> &b) {return a.first > b.first;});
+  for(const auto &e : entries)
+    if(sorter.getNext() != e.second) {
+      fail("MoveSorter", "", "wrong order");
+      return;
+    }
+  if(sorter.getNext()) fail("MoveSorter", "", "too many moves");
+}
+
+/**
+ * Transposition tables (with and without costs) against a model of their slots
+ */
+void checkTable() {
+  static constexpr int LOG_SIZE = 10;
+  TranspositionTable<uint16_t, uint64_t, uint8_t, LOG_SIZE> plain, costly;
+  costly.enableCosts();
+  const size_t size = next_prime(1 << LOG_SIZE);
+  struct Slot {uint64_t key; uint8_t value; uint8_t cost;};
+  std::map<size_t, Slot> plain_model, costly_model;
+  std::vector<uint64_t> keys;
+  for(int i = 0; i < 64; i++) keys.push_back(rng() & ((uint64_t(1) << 26) - 1)); // key < 2^26 identified by key % size and 16 low bits
+  for(int i = 0; i < 2000; i++) {
+    uint64_t key = keys[rng() % keys.size()] + (rng() % 4) * size;
+    uint8_t value = 1 + rng() % 255;
+    uint8_t cost = 1 + rng() % 40;
+    plain.put(key, value);
+    plain_model[key % size] = Slot{key, value, 0};
+    costly.put(key, value, cost);
+    Slot &s = costly_model[key % size];
+    if(s.cost > cost && s.key != key) s.cost--;
+    else s = Slot{key, value, cost};
+
+    uint64_t probe = keys[rng() % keys.size()] + (rng() % 4) * size;
+    auto p = plain_model.find(probe % size);
+    uint8_t expected = p != plain_model.end() && p->second.key == probe ? p->second.value : 0;
+    if(plain.get(probe) != expected) fail("TranspositionTable", "", str(int(plain.get(probe)), int(expected)));
+    auto c = costly_model.find(probe % size);
+    expected = c != costly_model.end() && c->second.key == probe ? c->second.value : 0;
+    uint8_t expected_cost = expected ? c->second.cost : 0;
+    if(costly.get(probe) != expected) fail("TranspositionTable with costs", "", str(int(costly.get(probe)), int(expected)));
+    if(costly.getCost(probe) != expected_cost) fail("TranspositionTable costs", "", str(int(costly.getCost(probe)), int(expected_cost)));
+  }
+}
+
+int sign(int v) {return (v > 0) - (v < 0);}
+
+/**
+ * Consistency of the solver entry points, and exact scores against the reference minimax near the end of the game
+ */
+void checkSolver(Solver &solver, Solver &costly, const std::string &moves, Board &B, const Position &P) {
+  if(B.canWinNext()) return; // solver entry points assume the game is not over
+  int score = solver.solve(P);
+  if(B.moves >= Position::WIDTH * Position::HEIGHT - 10) {
+    int expected = B.solve();
+    if(score != expected) fail("solve vs reference", moves, str(score, expected));
+  }
+  int s = costly.solve(P);
+  if(s != score) fail("solve with subtree sizes", moves, str(s, score));
+
+  std::vector<int> scores = solver.analyze(P);
+  int best = Solver::INVALID_MOVE;
+  for(int col = 0; col < Position::WIDTH; col++) {
+    if((scores[col] == Solver::INVALID_MOVE) == P.canPlay(col)) fail("analyze", moves, "invalid move " + std::to_string(col + 1));
+    best = std::max(best, scores[col]);
+    if(P.canPlay(col)) {
+      Position P2(P);
+      P2.playCol(col);
+      int child = P.isWinningMove(col) ? (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2 : -solver.solve(P2);
+      if(scores[col] != child) fail("analyze vs solve of child", moves, str(scores[col], child));
+    }
+  }
+  if(best != score) fail("analyze vs solve", moves, str(best, score));
+  std::vector<int> weak = solver.analyze(P, true);
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(P.canPlay(col) && sign(weak[col]) != sign(scores[col])) fail("weak analyze", moves, str(weak[col], scores[col]));
+  if(sign(solver.solve(P, true)) != sign(score)) fail("weak solve", moves, str(solver.solve(P, true), score));
+
+  int col = solver.bestMove(P);
+  if(col == Solver::INVALID_MOVE || scores[col] != score) fail("bestMove", moves, "column " + std::to_string(col + 1));
+  col = solver.bestMove(P, true);
+  if(col == Solver::INVALID_MOVE || sign(scores[col]) != sign(score)) fail("weak bestMove", moves, "column " + std::to_string(col + 1));
+
+  for(int t = score - 1; t <= score + 1; t++)
+    if(solver.scoreAtLeast(P, t) != (score >= t)) fail("scoreAtLeast", moves, str(solver.scoreAtLeast(P, t), score >= t));
+
+  for(int wide = 0; wide < 2; wide++) { // hints around the score, then anywhere, possibly beyond the possible scores
+    const int range = Position::WIDTH * Position::HEIGHT / 2;
+    int min_hint = wide ? int(rng() % (2 * range + 1)) - range : score - int(rng() % 5);
+    int max_hint = wide ? int(rng() % (2 * range + 1)) - range : score + int(rng() % 5) - 2;
+    if(max_hint < min_hint) std::swap(min_hint, max_hint);
+    int hinted = solver.solveWithHint(P, min_hint, max_hint);
+    int clamped = std::min(std::max(score, min_hint), max_hint);
+    if(hinted < min_hint || hinted > max_hint)
+      fail("solveWithHint", moves, "score " + std::to_string(hinted) + " outside [" + std::to_string(min_hint) + ";" + std::to_string(max_hint) + "]");
+    if(hinted != clamped) fail("solveWithHint", moves, str(hinted, clamped));
+  }
+
+  int min, max;
+  solver.reset();
+  bool solved = solver.solve(P, false, 1 + rng() % 1000, min, max);
+  if(min > score || max < score || solved != (min == max)) fail("solve with node budget", moves, "score outside the proven interval");
+}
+
+/**
+ * Interleaved batch solving against solve, with a fresh transposition table to run the searches together
+ */
+void checkBatch(Solver &solver, const std::vector<std::pair<std::string, Position>> &batch) {
+  std::vector<Position> positions;
+  for(const auto &p : batch) positions.push_back(p.second);
+  const bool weak = rng() % 2;
+  solver.reset();
+  std::vector<int> scores = solver.solveBatch(positions, weak, 1 + rng() % 16);
+  for(size_t i = 0; i < batch.size(); i++) {
+    int score = solver.solve(batch[i].second, weak);
+    if(scores[i] != score) fail(weak ? "weak solveBatch" : "solveBatch", batch[i].first, str(scores[i], score));
+  }
+}
+
+/**
+ * Add to found the positions obtained by removing plies top stones of alternating colors, by key3
+ */
+void ancestors(const Position &P, int plies, std::map<Position::position_t, Position> &found) {
+  if(plies == 0) {
+    found.insert(std::make_pair(P.key3(), P));
+    return;
+  }
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(P.canUndo(col)) {
+      Position P2(P);
+      P2.undoCol(col);
+      ancestors(P2, plies - 1, found);
+    }
+}
+
+/**
+ * Opening book fast paths and guesses: a small in-memory book is built with positions of BOOK_DEPTH moves
+ * solved without book. Positions inside the book and up to 4 moves beyond it are then solved, analyzed and
+ * their best move searched with the book, against the same calls without it.
+ */
+void checkBook(Solver &solver) {
+  static constexpr int BOOK_DEPTH = 22;
+  static constexpr int LOG_SIZE = 21;
+  static constexpr size_t SIZE = next_prime(1 << LOG_SIZE);
+  std::vector<uint32_t> keys(SIZE); // tables of the book file, keys3 at this depth are identified by 32 bits partial keys
+  std::vector<uint8_t> values(SIZE);
+  std::map<Position::position_t, int> book_scores; // by key3
+
+  std::vector<std::pair<std::string, Position>> queries;
+  for(int i = 0; i < 16; i++) {
+    Board B;
+    Position P;
+    const int length = BOOK_DEPTH - 1 + rng() % 6;
+    std::string moves = randomGame(B, P, length);
+    if(B.moves != length) continue;
+    std::map<Position::position_t, Position> book_positions;
+    if(length < BOOK_DEPTH) { // children are in the book
+      for(int col = 0; col < Position::WIDTH; col++)
+        if(P.canPlay(col) && !P.isWinningMove(col)) {
+          Position P2(P);
+          P2.playCol(col);
+          book_positions.insert(std::make_pair(P2.key3(), P2));
+        }
+    }
+    else ancestors(P, length - BOOK_DEPTH, book_positions);
+    for(const auto &b : book_positions)
+      if(!values[b.first % SIZE]) { // positions colliding with a previous one are left out of the book
+        int score = solver.solve(b.second);
+        book_scores[b.first] = score;
+        keys[b.first % SIZE] = uint32_t(b.first);
+        values[b.first % SIZE] = score - Position::MIN_SCORE + 1;
+      }
+    if(!B.canWinNext()) queries.push_back(std::make_pair(moves, P));
+  }
+
+  std::vector<char> data = {Position::WIDTH, Position::HEIGHT, BOOK_DEPTH, sizeof(uint32_t), sizeof(uint8_t), LOG_SIZE}; // header of the book file
+  data.insert(data.end(), reinterpret_cast<const char *>(keys.data()), reinterpret_cast<const char *>(keys.data() + SIZE));
+  data.insert(data.end(), values.begin(), values.end());
+  Solver booked;
+  booked.loadBook(data.data(), data.size());
+
+  for(const auto &q : queries) {
+    const std::string &moves = q.first;
+    const Position &P = q.second;
+    int score = solver.solve(P);
+    int s = booked.solve(P);
+    if(s != score) fail("solve with book", moves, str(s, score));
+
+    int w = booked.solve(P, true); // a loss, a draw, or a win with a lower bound of the score
+    if(score > 0 ? w < 1 || w > score : w != sign(score)) fail("weak solve with book", moves, str(w, score));
+    if(P.nbMoves() == BOOK_DEPTH + 1 && score > 1) { // each parent in the book gives a lower bound
+      std::map<Position::position_t, Position> parents;
+      ancestors(P, 1, parents);
+      int bound = 1;
+      for(const auto &p : parents) bound = std::max(bound, -book_scores[p.first]);
+      if(w < bound) fail("weak solve with book", moves, "score " + std::to_string(w) + " below the bound of the parents " + std::to_string(bound));
+    }
+
+    std::vector<int> scores = solver.analyze(P);
+    std::vector<int> analyzed = booked.analyze(P);
+    std::vector<int> weak = booked.analyze(P, true);
+    for(int col = 0; col < Position::WIDTH; col++) {
+      if(analyzed[col] != scores[col]) fail("analyze with book", moves, "column " + std::to_string(col + 1) + " " + str(analyzed[col], scores[col]));
+      if(sign(weak[col]) != sign(scores[col])) fail("weak analyze with book", moves, "column " + std::to_string(col + 1) + " " + str(weak[col], scores[col]));
+    }
+
+    int col = booked.bestMove(P);
+    if(col == Solver::INVALID_MOVE || scores[col] != score) fail("bestMove with book", moves, "column " + std::to_string(col + 1));
+    col = booked.bestMove(P, true);
+    if(col == Solver::INVALID_MOVE || sign(scores[col]) != sign(score)) fail("weak bestMove with book", moves, "column " + std::to_string(col + 1));
+
+    for(int t = score - 1; t <= score + 1; t++)
+      if(booked.scoreAtLeast(P, t) != (score >= t)) fail("scoreAtLeast with book", moves, str(booked.scoreAtLeast(P, t), score >= t));
+  }
+}
+
+/**
+ * Progress reported while solving a position needing several million nodes: the estimated
+ * fraction done stays between 0 and 1 and never decreases.
+ */
+void checkProgress() {
+  const std::string moves = "5523546";
+  Position P;
+  P.play(moves);
+  Solver solver;
+  double last = 0;
+  int reports = 0;
+  solver.setProgressCallback([&](const Solver::Progress &p) {
+    if(p.done < last || p.done > 1) fail("progress", moves, str(p.done, last));
+    last = p.done;
+    reports++;
+  }, 0);
+  solver.solve(P);
+  if(reports < 2) fail("progress", moves, "only " + std::to_string(reports) + " reports");
+}
+
+/**
+ * Differential fuzzing harness.
+ * Generates random legal positions and compares the optimized bitboard primitives, move sorter,
+ * transposition tables, solver entry points and batch solving against slow reference implementations.
+ * Also checks the solver with a small opening book against the solver without book, and that the
+ * progress of a longer solve is monotonic.
+ *
+ * Parameters:
+ *  - seed (default 1), 0 for a time based seed
+ *  - number of iterations (default 1000), 0 to run until a failure is found
+ *
+ * Returns 1 if any check failed.
+ */
+int main(int argc, char** argv) {
+  unsigned long long seed = argc > 1 ? strtoull(argv[1], 0, 10) : 1;
+  unsigned long long iterations = argc > 2 ? strtoull(argv[2], 0, 10) : 1000;
+  if(!seed) seed = time(0);
+  rng.seed(seed);
+  std::cerr << "seed: " << seed << std::endl;
+
+  checkProgress();
+  Solver solver, costly;
+  checkBook(solver);
+  std::vector<std::pair<std::string, Position>> batch;
+  costly.enableCosts(Position::WIDTH * Position::HEIGHT);
+  for(iteration = 1; !iterations || iteration <= iterations; iteration++) {
+    Board B;
+    Position P;
+    std::string moves = randomGame(B, P, rng() % (Position::WIDTH * Position::HEIGHT));
+    Board B2;
+    Position P2;
+    for(size_t i = 0; i <= moves.size(); i++) { // check every prefix
+      checkPosition(moves.substr(0, i), B2, P2);
+      if(i < moves.size()) {
+        B2.play(moves[i] - '1');
+        P2.playCol(moves[i] - '1');
+      }
+    }
+    checkSorter();
+    if(iteration % 16 == 0) checkTable();
+    if(failures) return 1; // the solver relies on the checked primitives
+    if(B.moves >= 20) checkSolver(solver, costly, moves, B, P); // earlier positions are too expensive to solve
+    if(B.moves >= 20 && !B.canWinNext()) batch.push_back(std::make_pair(moves, P));
+    if(batch.size() == 64) {
+      checkBatch(solver, batch);
+      batch.clear();
+    }
+    if(failures) return 1;
+    if(iteration % 1000 == 0) {
+      checkBook(solver); // with other random positions for long runs
+      std::cerr << iteration << " iterations" << std::endl;
+    }
+  }
+  std::cerr << "ok: " << iteration - 1 << " iterations" << std::endl;
+  return 0;
+}
@@ -18,14 +18,33 @@
 
 #include "Solver.hpp"
 #include <iostream>
+#include <iomanip>
+#include <cstdlib>
 
 using namespace GameSolver::Connect4;
 
+#ifdef EMBEDDED_BOOK
+// The opening book file given by EMBEDDED_BOOK is included in the read-only data of the executable.
+// The 6 bytes header is offset so that the tables are 8 bytes aligned and used without copy.
+asm(".section .rodata\n"
+    ".balign 8\n"
+    ".skip 2\n"
+    "embedded_book:\n"
+    ".incbin \"" EMBEDDED_BOOK "\"\n"
+    "embedded_book_end:\n"
+    ".previous\n");
+extern "C" const char embedded_book[], embedded_book_end[];
+#endif
+
 /**
  * Main function.
  * Reads Connect 4 positions, line by line, from standard input
  * and writes one line per position to standard output containing:
- *  - score of the position
+ *  - score of the position (or scores of all possible moves with -a, or 1-based column of a best move with -m,
+ *    or [min;max] interval proven to contain the score when the node budget given with -n is exhausted,
+ *    or 1/0 whether the score is at least the threshold given with -t)
+ *    With -s, the analysis line is preceded by one line per column as soon as its score is proven:
+ *    "position column <column> score <score> best <best column so far>".
  *  - number of nodes explored
  *  - time spent in microsecond to solve the position.
  *
@@ -33,11 +52,28 @@ using namespace GameSolver::Connect4;
  *  will generate an error message to standard error and an empty line to standard output.
  */
 int main(int argc, char** argv) {
+  Tracer tracer;
   Solver solver;
   bool weak = false;
   bool analyze = false;
+  bool stream = false;
+  bool best_move = false;
+  unsigned long long max_nodes = 0; // 0 means no limit
+  bool threshold_query = false;
+  int threshold = 0;
+  bool hint = false;
+  std::string checkpoint_file;
+  double checkpoint_interval = 600;
+  bool resume = false;
+  bool background_book = false;
+  std::string learned_book;
+  int batch_lanes = 0; // 0 means positions are solved one after the other
+  int min_hint = -Position::WIDTH * Position::HEIGHT, max_hint = Position::WIDTH * Position::HEIGHT; // default hints contain any score
 
   std::string opening_book = "7x6.book";
+#ifdef EMBEDDED_BOOK
+  opening_book.clear(); // use the embedded opening book unless -b is given
+#endif
   for(int i = 1; i < argc; i++) {
     if(argv[i][0] == '-') {
       if(argv[i][1] == 'w') weak = true; // parameter -w: use weak solver
@@ -47,22 +83,129 @@ int main(int argc, char** argv) {
       else if(argv[i][1] == 'a') { // paramater -a: make an analysis of all possible moves
         analyze = true;
       }
+      else if(argv[i][1] == 's') { // parameter -s: analysis printing each column score as soon as it is proven
+        analyze = stream = true;
+      }
+      else if(argv[i][1] == 'm') { // parameter -m: only look for a best move
+        best_move = true;
+      }
+      else if(argv[i][1] == 'p') { // parameter -p: periodically print search progress to standard error
+        solver.setProgressCallback([](const Solver::Progress &p) {
+          std::cerr << "progress: " << std::fixed << std::setprecision(1) << 100 * p.done << "% nodes: " << p.nodes
+                    << " elapsed: " << std::setprecision(0) << p.elapsed << "s eta: " << p.eta << "s" << std::endl;
+        });
+      }
+      else if(argv[i][1] == 'n') { // parameter -n: maximum number of nodes to explore per position
+        if(++i < argc) max_nodes = strtoull(argv[i], 0, 10);
+      }
+      else if(argv[i][1] == 't') { // parameter -t: only check if the score is at least a threshold
+        if(++i < argc) threshold = atoi(argv[i]);
+        threshold_query = true;
+      }
+      else if(argv[i][1] == 'l') { // parameter -l: lower bound hint of the scores to solve
+        if(++i < argc) min_hint = atoi(argv[i]);
+        hint = true;
+      }
+      else if(argv[i][1] == 'u') { // parameter -u: upper bound hint of the scores to solve
+        if(++i < argc) max_hint = atoi(argv[i]);
+        hint = true;
+      }
+      else if(argv[i][1] == 'c') { // parameter -c: periodically save the solver state in a checkpoint file
+        if(++i < argc) checkpoint_file = argv[i];
+      }
+      else if(argv[i][1] == 'k') { // parameter -k: time between two checkpoints in seconds
+        if(++i < argc) checkpoint_interval = atof(argv[i]);
+      }
+      else if(argv[i][1] == '-' && std::string(argv[i]) == "--resume") { // parameter --resume: resume from the checkpoint file
+        resume = true;
+      }
+      else if(argv[i][1] == '-' && std::string(argv[i]) == "--background-book") { // parameter --background-book: load the opening book
+        background_book = true; // in a background thread, first positions are solved without it (weak scores may differ)
+      }
+      else if(argv[i][1] == 'd') { // parameter -d: use a second tier transposition table stored in a file
+        if(++i < argc && !solver.enableDiskTable(argv[i])) {
+          std::cerr << "Unable to use the disk transposition table: " << argv[i] << std::endl;
+          return 1;
+        }
+      }
+      else if(argv[i][1] == 'L') { // parameter -L: record expensive positions in a learned book file, used by later runs
+        if(++i < argc) learned_book = argv[i];
+      }
+      else if(argv[i][1] == 'T') { // parameter -T: write a timeline of the searches in Chrome trace format
+        if(++i < argc && tracer.open(argv[i])) solver.setTracer(&tracer);
+      }
+      else if(argv[i][1] == 'S') { // parameter -S: record subtree sizes in the transposition table, also used
+        if(++i < argc) solver.enableCosts(atoi(argv[i]));  // for move ordering of positions with less moves than given
+      }
+      else if(argv[i][1] == 'B') { // parameter -B: solve all the positions as a batch of interleaved searches
+        if(++i < argc) batch_lanes = atoi(argv[i]);
+      }
+      else if(argv[i][1] == 'o') { // parameter -o: define move ordering weights (as given by the tuner)
+        MoveOrdering ordering;
+        if(++i < argc && ordering.parse(argv[i])) solver.setMoveOrdering(ordering);
+        else std::cerr << "Invalid move ordering weights" << std::endl;
+      }
     }
   }
-  solver.loadBook(opening_book);
+  if(!checkpoint_file.empty()) solver.setCheckpoint(checkpoint_file, checkpoint_interval, resume);
+  if(!learned_book.empty()) solver.enableLearnedBook(learned_book);
+#ifdef EMBEDDED_BOOK
+  if(opening_book.empty()) solver.loadBook(embedded_book, embedded_book_end - embedded_book);
+  else
+#endif
+  solver.loadBook(opening_book, background_book);
 
   std::string line;
 
+  if(batch_lanes > 0 && !analyze && !best_move && !threshold_query && !max_nodes && !hint) { // only for scores
+    std::vector<std::string> lines;
+    std::vector<Position> positions;
+    for(int l = 1; std::getline(std::cin, line); l++) {
+      Position P;
+      if(P.play(line) != line.size()) {
+        std::cerr << "Line " << l << ": Invalid move " << (P.nbMoves() + 1) << " \"" << line << "\"" << std::endl;
+      } else {
+        lines.push_back(line);
+        positions.push_back(P);
+      }
+    }
+    std::vector<int> scores = solver.solveBatch(positions, weak, batch_lanes);
+    for(size_t i = 0; i < lines.size(); i++) std::cout << lines[i] << " " << scores[i] << std::endl;
+    if(!learned_book.empty()) solver.saveLearnedBook();
+    return 0;
+  }
+
   for(int l = 1; std::getline(std::cin, line); l++) {
     Position P;
     if(P.play(line) != line.size()) {
       std::cerr << "Line " << l << ": Invalid move " << (P.nbMoves() + 1) << " \"" << line << "\"" << std::endl;
     } else {
-      std::cout << line;
+      if(!stream) std::cout << line;
       if(analyze) {
-        std::vector<int> scores = solver.analyze(P, weak);
+        Solver::AnalyzeCallback callback = nullptr;
+        if(stream) callback = [&line](int col, int score, int best) { // 1-based columns as in the input sequences
+          std::cout << line << " column " << col + 1 << " score " << score << " best " << best + 1 << std::endl;
+        };
+        std::vector<int> scores = solver.analyze(P, weak, callback);
+        if(stream) std::cout << line; // streamed lines are followed by the usual analysis line
         for(int i = 0; i < Position::WIDTH; i++) std::cout << " " << scores[i];
       }
+      else if(best_move) {
+        int col = solver.bestMove(P, weak);
+        std::cout << " " << (col == Solver::INVALID_MOVE ? col : col + 1); // output 1-based column as in the input sequences
+      }
+      else if(threshold_query) {
+        std::cout << " " << solver.scoreAtLeast(P, threshold); // 1 if score >= threshold, 0 otherwise
+      }
+      else if(max_nodes) {
+        int min, max;
+        if(solver.solve(P, weak, max_nodes, min, max)) std::cout << " " << min;
+        else std::cout << " [" << min << ";" << max << "]"; // proven interval when the node budget is exhausted
+      }
+      else if(hint) { // -w is ignored with hints, use -l -1 -u 1 instead
+        int score = solver.solveWithHint(P, min_hint, max_hint);
+        std::cout << " " << score;
+      }
       else {
         int score = solver.solve(P, weak);
         std::cout << " " << score;
@@ -70,4 +213,5 @@ int main(int argc, char** argv) {
       std::cout << std::endl;
     }
   }
+  if(!learned_book.empty()) solver.saveLearnedBook();
 }
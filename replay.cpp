@@ -0,0 +1,167 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Solver.hpp"
+#include "Scheduler.hpp"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace GameSolver::Connect4;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * A recorded query
+ */
+struct Query {
+  double timestamp; // time of the query in seconds since the beginning of the log
+  std::string mode; // solve, weak, analyze or best
+  Position position;
+  Clock::time_point scheduled; // replay time at which the query is submitted
+  double latency;   // time between submission and answer in seconds
+  bool hard;        // scheduled as a hard query
+};
+
+/**
+ * Answer the queries of the scheduler with its own solver until the scheduler is closed
+ */
+void worker(Scheduler<Query> &scheduler, Solver &solver, bool dedicated) {
+  while(Query *q = scheduler.pop(dedicated)) {
+    if(q->mode == "analyze") solver.analyze(q->position);
+    else if(q->mode == "best") solver.bestMove(q->position);
+    else solver.solve(q->position, q->mode == "weak");
+    q->latency = std::chrono::duration<double>(Clock::now() - q->scheduled).count();
+  }
+}
+
+double percentile(const std::vector<double> &sorted, double p) {
+  if(sorted.empty()) return 0;
+  size_t i = size_t(p * sorted.size());
+  return sorted[i < sorted.size() ? i : sorted.size() - 1];
+}
+
+void report(const char *name, std::vector<double> &latencies) {
+  if(latencies.empty()) return;
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << std::setprecision(3) << name << " p50: " << percentile(latencies, 0.5) * 1000 << "ms p99: "
+            << percentile(latencies, 0.99) * 1000 << "ms p999: " << percentile(latencies, 0.999) * 1000
+            << "ms max: " << latencies.back() * 1000 << "ms" << std::endl;
+}
+
+/**
+ * Query replay load-testing tool.
+ * Reads a log of recorded queries from standard input, one per line:
+ *   timestamp mode position
+ * where timestamp is in seconds, mode is solve, weak, analyze or best, and position a sequence of moves.
+ * Queries are submitted at their recorded time (relative to the first one) divided by the rate
+ * multiplier, and answered by concurrent workers, each with its own solver.
+ *
+ * Parameters:
+ *  -j <n>: number of concurrent workers (default 1)
+ *  -r <x>: rate multiplier (default 1), 0 to submit all the queries at once
+ *  -b <file>: opening book loaded by each worker
+ *  -D <x>: difficulty threshold of hard queries (see Solver::estimateDifficulty), queries are answered
+ *          in submission order without threshold, otherwise easy queries are answered first
+ *  -H <n>: number of workers dedicated to hard queries (default 0), other workers only answer easy queries
+ *
+ * Writes the throughput and the latency percentiles (from submission to answer) to standard output,
+ * also for easy and hard queries separately when a difficulty threshold is given.
+ */
+int main(int argc, char** argv) {
+  int concurrency = 1;
+  double rate = 1;
+  std::string opening_book;
+  double threshold = 1e300; // no hard query
+  int hard_workers = 0;
+  for(int i = 1; i < argc; i++) {
+    if(argv[i][0] == '-') {
+      if(argv[i][1] == 'j') { // parameter -j: number of workers
+        if(++i < argc) concurrency = std::max(1, atoi(argv[i]));
+      }
+      else if(argv[i][1] == 'r') { // parameter -r: rate multiplier
+        if(++i < argc) rate = atof(argv[i]);
+      }
+      else if(argv[i][1] == 'b') { // parameter -b: opening book
+        if(++i < argc) opening_book = argv[i];
+      }
+      else if(argv[i][1] == 'D') { // parameter -D: difficulty threshold of hard queries
+        if(++i < argc) threshold = atof(argv[i]);
+      }
+      else if(argv[i][1] == 'H') { // parameter -H: number of workers dedicated to hard queries
+        if(++i < argc) hard_workers = std::max(0, atoi(argv[i]));
+      }
+    }
+  }
+
+  std::vector<Query> queries;
+  std::string line;
+  for(int l = 1; std::getline(std::cin, line); l++) {
+    std::istringstream iss(line);
+    Query q;
+    std::string moves;
+    iss >> q.timestamp >> q.mode >> moves; // moves are missing for the empty position
+    if(q.mode.empty() || q.position.play(moves) != moves.size()
+        || (q.mode != "solve" && q.mode != "weak" && q.mode != "analyze" && q.mode != "best")) {
+      std::cerr << "Line " << l << ": Invalid query \"" << line << "\"" << std::endl;
+      continue;
+    }
+    queries.push_back(q);
+  }
+  if(queries.empty()) return 0;
+  std::stable_sort(queries.begin(), queries.end(), [](const Query &a, const Query &b) {return a.timestamp < b.timestamp;});
+
+  std::vector<Solver> solvers(concurrency); // solvers are initialized before the replay starts
+  if(!opening_book.empty())
+    for(Solver &solver : solvers) solver.loadBook(opening_book);
+
+  if(hard_workers >= concurrency) hard_workers = concurrency - 1; // keep a worker for easy queries
+  Scheduler<Query> scheduler(threshold, hard_workers);
+  std::vector<std::thread> workers;
+  for(int i = 0; i < concurrency; i++)
+    workers.push_back(std::thread(worker, std::ref(scheduler), std::ref(solvers[i]), i < hard_workers));
+
+  Clock::time_point start = Clock::now();
+  for(Query &q : queries) {
+    double delay = rate > 0 ? (q.timestamp - queries[0].timestamp) / rate : 0;
+    q.scheduled = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(delay));
+    std::this_thread::sleep_until(q.scheduled);
+    q.hard = scheduler.push(&q, solvers[0].estimateDifficulty(q.position)); // only reads the opening book
+  }
+  scheduler.close();
+  for(std::thread &t : workers) t.join();
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<double> latencies, easy_latencies, hard_latencies;
+  for(const Query &q : queries) {
+    latencies.push_back(q.latency);
+    (q.hard ? hard_latencies : easy_latencies).push_back(q.latency);
+  }
+  std::cout << "queries: " << queries.size() << " workers: " << concurrency << " rate: " << rate << std::endl;
+  std::cout << std::fixed << std::setprecision(1) << "throughput: " << queries.size() / elapsed << " queries/s" << std::endl;
+  report("latency", latencies);
+  if(threshold < 1e300) {
+    std::cout << "hard queries: " << hard_latencies.size() << " dedicated workers: " << hard_workers << std::endl;
+    report("easy latency", easy_latencies);
+    report("hard latency", hard_latencies);
+  }
+}
@@ -0,0 +1,239 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Solver.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace GameSolver::Connect4;
+
+/**
+ * Message exchanged between the worker processes through their inbox pipes.
+ * Messages are smaller than PIPE_BUF so that concurrent writes to a same inbox are atomic.
+ * Positions are sent as raw bytes as all the workers are forks of the same process.
+ */
+struct Message {
+  enum Type {REQUEST, RESPONSE, QUIT};
+  Type type;
+  int from;      // worker sending the message
+  uint64_t id;   // request id, unique for the requesting worker
+  Position P;    // requested position
+  int alpha;     // requested window
+  int beta;
+  int score;     // response
+};
+
+/**
+ * Worker process owning the partition of the positions whose key modulo the number of workers is its index.
+ *
+ * Positions up to a given depth are searched by their owner, using its transposition table:
+ * a worker sends a request to the owner and, while waiting for the response, serves the requests
+ * received from the other workers so that workers waiting for each other cannot deadlock.
+ * Deeper positions are searched locally.
+ */
+class Worker {
+ public:
+  Worker(int index, const std::vector<int> &inboxes_read, const std::vector<int> &inboxes_write, int depth, const std::string &book)
+    : index{index}, inbox{inboxes_read[index]}, inboxes{inboxes_write}, nextId{0}, served{0}, sent{0} {
+    if(!book.empty()) solver.loadBook(book);
+    solver.setRemoteSearch([this](const Position &P, int alpha, int beta, int &score) {
+      return remote(P, alpha, beta, score);
+    }, depth);
+  }
+
+  Solver solver;
+
+  // Serve requests until a QUIT message is received
+  void serve() {
+    Message m;
+    while(receive(m) && m.type != Message::QUIT)
+      if(m.type == Message::REQUEST) answer(m);
+  }
+
+  // Ask all the workers, including this one, to stop serving
+  void quit() {
+    Message m = Message();
+    m.type = Message::QUIT;
+    m.from = index;
+    for(int inbox : inboxes) send(inbox, m);
+  }
+
+  void report() const {
+    std::cerr << "worker " << index << ": requests sent: " << sent << " served: " << served
+              << " nodes: " << solver.getNodeCount() << std::endl;
+  }
+
+ private:
+  const int index;
+  const int inbox;              // read end of the inbox pipe of this worker
+  const std::vector<int> inboxes; // write ends of the inbox pipes of all the workers
+  uint64_t nextId;
+  std::map<uint64_t, int> responses; // responses received while serving nested requests
+  unsigned long long served, sent;
+
+  int owner(const Position &P) const {
+    return int(P.key() % inboxes.size());
+  }
+
+  bool remote(const Position &P, int alpha, int beta, int &score) {
+    const int o = owner(P);
+    if(o == index) return false;
+    Message m = Message();
+    m.type = Message::REQUEST;
+    m.from = index;
+    m.id = nextId++;
+    m.P = P;
+    m.alpha = alpha;
+    m.beta = beta;
+    send(inboxes[o], m);
+    sent++;
+    score = wait(m.id);
+    return true;
+  }
+
+  // wait for the response of a request, serving the requests of the other workers meanwhile
+  int wait(uint64_t id) {
+    for(;;) {
+      std::map<uint64_t, int>::iterator it = responses.find(id);
+      if(it != responses.end()) {
+        int score = it->second;
+        responses.erase(it);
+        return score;
+      }
+      Message m;
+      if(!receive(m)) exit(1);
+      if(m.type == Message::RESPONSE) responses[m.id] = m.score;
+      else if(m.type == Message::REQUEST) answer(m);
+    }
+  }
+
+  void answer(const Message &request) {
+    Message m(request);
+    m.type = Message::RESPONSE;
+    m.score = solver.searchWindow(request.P, request.alpha, request.beta);
+    served++;
+    send(inboxes[request.from], m);
+  }
+
+  static void send(int fd, const Message &m) {
+    if(write(fd, &m, sizeof(m)) != sizeof(m)) {
+      std::cerr << "Unable to send message: " << strerror(errno) << std::endl;
+      exit(1);
+    }
+  }
+
+  bool receive(Message &m) {
+    char *buffer = reinterpret_cast<char *>(&m);
+    for(size_t done = 0; done < sizeof(m);) {
+      ssize_t r = read(inbox, buffer + done, sizeof(m) - done);
+      if(r <= 0) {
+        if(r < 0 && errno == EINTR) continue;
+        return false;
+      }
+      done += r;
+    }
+    return true;
+  }
+};
+
+/**
+ * Transposition-driven scheduling across local worker processes.
+ * Reads positions, line by line, from standard input and writes their score to standard output,
+ * as c4solver does. The positions are solved by several processes, each owning the transposition
+ * table entries of a partition of the positions (by key modulo the number of processes).
+ *
+ * Parameters:
+ *  -j <n>: number of worker processes (default 4)
+ *  -D <depth>: positions with up to this number of moves are searched by their owner,
+ *              deeper positions are searched locally (default 20)
+ *  -b <file>: opening book loaded by each worker
+ *  -w: weak solver
+ *
+ * Writes the number of requests and nodes of each worker to standard error.
+ */
+int main(int argc, char** argv) {
+  int nb_workers = 4;
+  int depth = 20;
+  bool weak = false;
+  std::string opening_book;
+  for(int i = 1; i < argc; i++) {
+    if(argv[i][0] == '-') {
+      if(argv[i][1] == 'j') { // parameter -j: number of worker processes
+        if(++i < argc) nb_workers = std::max(1, atoi(argv[i]));
+      }
+      else if(argv[i][1] == 'D') { // parameter -D: max depth of the positions searched by their owner
+        if(++i < argc) depth = atoi(argv[i]);
+      }
+      else if(argv[i][1] == 'b') { // parameter -b: opening book
+        if(++i < argc) opening_book = argv[i];
+      }
+      else if(argv[i][1] == 'w') weak = true; // parameter -w: use weak solver
+    }
+  }
+  static_assert(sizeof(Message) <= PIPE_BUF, "Messages must be written atomically");
+
+  std::vector<int> inboxes_read(nb_workers), inboxes_write(nb_workers);
+  for(int i = 0; i < nb_workers; i++) {
+    int fds[2];
+    if(pipe(fds)) {
+      std::cerr << "Unable to create pipe: " << strerror(errno) << std::endl;
+      return 1;
+    }
+    inboxes_read[i] = fds[0];
+    inboxes_write[i] = fds[1];
+  }
+
+  std::vector<pid_t> children;
+  for(int i = 1; i < nb_workers; i++) { // worker 0 is this process, reading the positions
+    pid_t pid = fork();
+    if(pid < 0) {
+      std::cerr << "Unable to fork: " << strerror(errno) << std::endl;
+      return 1;
+    }
+    if(pid == 0) {
+      Worker worker(i, inboxes_read, inboxes_write, depth, opening_book);
+      worker.serve();
+      worker.report();
+      return 0;
+    }
+    children.push_back(pid);
+  }
+
+  Worker worker(0, inboxes_read, inboxes_write, depth, opening_book);
+  std::string line;
+  for(int l = 1; std::getline(std::cin, line); l++) {
+    Position P;
+    if(P.play(line) != line.size()) {
+      std::cerr << "Line " << l << ": Invalid move " << (P.nbMoves() + 1) << " \"" << line << "\"" << std::endl;
+    } else {
+      std::cout << line << " " << worker.solver.solve(P, weak) << std::endl;
+    }
+  }
+  worker.quit();
+  worker.report();
+  for(pid_t pid : children) waitpid(pid, 0, 0);
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Solver.hpp"
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+using namespace GameSolver::Connect4;
+
+/**
+ * Solve all the training positions with a given move ordering
+ * @return total number of explored nodes.
+ */
+unsigned long long evaluate(Solver &solver, const std::vector<Position> &positions, const MoveOrdering &ordering) {
+  unsigned long long nodes = 0;
+  solver.setMoveOrdering(ordering);
+  for(const Position &P : positions) {
+    solver.reset(); // each position is solved from an empty transposition table
+    solver.solve(P);
+    nodes += solver.getNodeCount();
+  }
+  return nodes;
+}
+
+/**
+ * Move ordering tuner.
+ * Reads training positions, line by line, from standard input, and searches
+ * for the move ordering weights minimizing the total number of explored nodes
+ * to solve all of them.
+ *
+ * Optional parameters:
+ *  - initial weights as a comma separated list (default is solver default weights)
+ *  - maximum number of optimization rounds (default 10)
+ *
+ * The search is a coordinate descent: each weight is in turn increased or decreased
+ * by a step while it improves the total number of nodes. Step is halved when no
+ * weight can be improved. Progress is written to standard error and final weights
+ * to standard output.
+ */
+int main(int argc, char** argv) {
+  Solver solver;
+  MoveOrdering best;
+  if(argc > 1 && !best.parse(argv[1])) {
+    std::cerr << "Invalid weights: " << argv[1] << std::endl;
+    return 1;
+  }
+  int rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+  std::vector<Position> positions;
+  std::string line;
+  for(int l = 1; std::getline(std::cin, line); l++) {
+    Position P;
+    if(P.play(line) != line.size())
+      std::cerr << "Line " << l << ": Invalid move " << (P.nbMoves() + 1) << " \"" << line << "\"" << std::endl;
+    else positions.push_back(P);
+  }
+
+  unsigned long long best_nodes = evaluate(solver, positions, best);
+  std::cerr << best.toString() << " " << best_nodes << std::endl;
+
+  int step = 1;
+  for(int i = 0; i < MoveOrdering::NB_FEATURES; i++) // initial step is the largest weight
+    if(std::abs(best.weight[i]) > step) step = std::abs(best.weight[i]);
+
+  for(int round = 0; round < rounds && step > 0; round++) {
+    bool improved = false;
+    for(int f = 0; f < MoveOrdering::NB_FEATURES; f++)
+      for(int direction = -1; direction <= 1; direction += 2) {
+        for(;;) { // keep going in the same direction as long as it improves
+          MoveOrdering candidate = best;
+          candidate.weight[f] += direction * step;
+          unsigned long long nodes = evaluate(solver, positions, candidate);
+          std::cerr << candidate.toString() << " " << nodes << std::endl;
+          if(nodes >= best_nodes) break;
+          best = candidate;
+          best_nodes = nodes;
+          improved = true;
+        }
+      }
+    if(!improved) step /= 2;
+  }
+  std::cout << best.toString() << std::endl;
+}